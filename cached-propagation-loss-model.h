@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CACHED_PROPAGATION_LOSS_MODEL_H
+#define CACHED_PROPAGATION_LOSS_MODEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/wifi-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Wraps the loss model (chain) of a channel and remembers the loss in dB of
+ * every (tx, rx) mobility pair the first time it is computed. An entry is
+ * dropped only when one of the two models fires CourseChange, so with
+ * constant positions every pair is computed exactly once per run.
+ *
+ * Only valid for deterministic inner models (LogDistance, Friis, ...):
+ * fading models would be frozen at their first sample.
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+  CachedPropagationLossModel ();
+
+  void SetInner (Ptr<PropagationLossModel> inner);
+
+  uint64_t GetHits (void) const;
+  uint64_t GetMisses (void) const;
+
+private:
+  virtual double DoCalcRxPower (double txPowerDbm,
+                                Ptr<MobilityModel> a,
+                                Ptr<MobilityModel> b) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  uint32_t GetIndex (Ptr<MobilityModel> model) const;
+  void CourseChanged (Ptr<const MobilityModel> model) const;
+
+  Ptr<PropagationLossModel> m_inner;
+
+  // dense [tx][rx] table of losses in dB, NaN when not cached. Rows are
+  // grown lazily so a STA->AP only workload stays small.
+  mutable std::unordered_map<const MobilityModel *, uint32_t> m_index;
+  mutable std::vector< std::vector<double> > m_loss;
+  mutable uint64_t m_hits;
+  mutable uint64_t m_misses;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationLossModel);
+
+TypeId
+CachedPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CachedPropagationLossModel")
+    .SetParent<PropagationLossModel> ()
+    .AddConstructor<CachedPropagationLossModel> ()
+  ;
+  return tid;
+}
+
+CachedPropagationLossModel::CachedPropagationLossModel ()
+  : m_hits (0),
+    m_misses (0)
+{
+}
+
+void
+CachedPropagationLossModel::SetInner (Ptr<PropagationLossModel> inner)
+{
+  m_inner = inner;
+}
+
+uint64_t
+CachedPropagationLossModel::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint64_t
+CachedPropagationLossModel::GetMisses (void) const
+{
+  return m_misses;
+}
+
+uint32_t
+CachedPropagationLossModel::GetIndex (Ptr<MobilityModel> model) const
+{
+  std::unordered_map<const MobilityModel *, uint32_t>::const_iterator it = m_index.find (PeekPointer (model));
+  if (it != m_index.end ())
+    {
+      return it->second;
+    }
+  uint32_t index = m_index.size ();
+  m_index[PeekPointer (model)] = index;
+  m_loss.push_back (std::vector<double> ());
+  model->TraceConnectWithoutContext ("CourseChange",
+                                     MakeCallback (&CachedPropagationLossModel::CourseChanged, this));
+  return index;
+}
+
+void
+CachedPropagationLossModel::CourseChanged (Ptr<const MobilityModel> model) const
+{
+  std::unordered_map<const MobilityModel *, uint32_t>::const_iterator it = m_index.find (PeekPointer (model));
+  if (it == m_index.end ())
+    {
+      return;
+    }
+  uint32_t index = it->second;
+  double invalid = std::numeric_limits<double>::quiet_NaN ();
+  std::fill (m_loss[index].begin (), m_loss[index].end (), invalid);
+  for (std::vector< std::vector<double> >::iterator row = m_loss.begin (); row != m_loss.end (); ++row)
+    {
+      if (index < row->size ())
+        {
+          (*row)[index] = invalid;
+        }
+    }
+}
+
+double
+CachedPropagationLossModel::DoCalcRxPower (double txPowerDbm,
+                                           Ptr<MobilityModel> a,
+                                           Ptr<MobilityModel> b) const
+{
+  NS_ASSERT_MSG (m_inner != 0, "CachedPropagationLossModel needs an inner model");
+  uint32_t tx = GetIndex (a);
+  uint32_t rx = GetIndex (b);
+  std::vector<double> &row = m_loss[tx];
+  if (rx >= row.size ())
+    {
+      row.resize (rx + 1, std::numeric_limits<double>::quiet_NaN ());
+    }
+  if (std::isnan (row[rx]))
+    {
+      m_misses++;
+      row[rx] = txPowerDbm - m_inner->CalcRxPower (txPowerDbm, a, b);
+    }
+  else
+    {
+      m_hits++;
+    }
+  return txPowerDbm - row[rx];
+}
+
+int64_t
+CachedPropagationLossModel::DoAssignStreams (int64_t stream)
+{
+  return m_inner->AssignStreams (stream);
+}
+
+/*
+ * Put a cache in front of whatever loss model the channel helper created.
+ */
+inline Ptr<CachedPropagationLossModel>
+EnablePathLossCache (Ptr<YansWifiChannel> channel)
+{
+  PointerValue inner;
+  channel->GetAttribute ("PropagationLossModel", inner);
+  Ptr<CachedPropagationLossModel> cache = CreateObject<CachedPropagationLossModel> ();
+  cache->SetInner (inner.Get<PropagationLossModel> ());
+  channel->SetPropagationLossModel (cache);
+  return cache;
+}
+
+} // namespace ns3
+
+#endif /* CACHED_PROPAGATION_LOSS_MODEL_H */
@@ -24,6 +24,11 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 
+#include "cached-propagation-loss-model.h"
+#include "pcapng-capture.h"
+#include "waypoint-trace-mobility-model.h"
+#include "wifi-phy-mode.h"
+
 #include <string>
 #include <list>
 #include <boost/lexical_cast.hpp>
@@ -218,14 +223,28 @@ int main (int argc, char *argv[])
     bool verbose = true;
     uint32_t nWifi = 2;
     bool tracing = true;
+    bool staticNodes = false;
+    std::string mobilityTrace;
+    std::string phyMode = "11a:0";
+    std::string pcapMode = "all";
+    uint32_t pcapEvery = 10;
 
     CommandLine cmd;
     cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
     cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
     cmd.AddValue ("tracing", "Enable pcap tracing", tracing);
+    cmd.AddValue ("pcapMode", "Devices in the capture: all, ap or sample", pcapMode);
+    cmd.AddValue ("pcapEvery", "With pcapMode=sample, capture every n-th station", pcapEvery);
+    cmd.AddValue ("staticNodes", "Fixed install: constant STA positions and cached path loss", staticNodes);
+    cmd.AddValue ("mobilityTrace", "Binary waypoint trace driving the STAs (see waypoint-trace-convert)", mobilityTrace);
+    cmd.AddValue ("phyMode", "Standard and MCS of all devices: 11a:0-7, 11n:0-7, 11ac:0-8 or 11ax:0-11", phyMode);
 
     cmd.Parse (argc,argv);
 
+    NS_ABORT_MSG_IF (staticNodes && !mobilityTrace.empty (), "staticNodes and mobilityTrace are exclusive");
+    WifiPhyMode mode;
+    NS_ABORT_MSG_IF (!ParseWifiPhyMode (phyMode, mode), "Unknown phyMode " << phyMode);
+
     Packet::EnablePrinting ();
 
     // Check for valid number of csma or wifi nodes
@@ -261,10 +280,16 @@ int main (int argc, char *argv[])
 
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
     YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
-    phy.SetChannel (channel.Create ());
+    Ptr<YansWifiChannel> wifiChannel = channel.Create ();
+    phy.SetChannel (wifiChannel);
+    if (staticNodes)
+      {
+        EnablePathLossCache (wifiChannel);
+      }
 
     WifiHelper wifi;
-    wifi.SetRemoteStationManager ("ns3::AarfWifiManager");
+    // Aarf has no HT rates, Minstrel takes over from 11n on
+    ApplyWifiPhyMode (wifi, mode, mode.standard == WIFI_PHY_STANDARD_80211a ? "ns3::AarfWifiManager" : "ns3::MinstrelHtWifiManager");
 
     WifiMacHelper mac;
     Ssid ssid = Ssid ("ns-3-ssid");
@@ -278,6 +303,7 @@ int main (int argc, char *argv[])
 
     NetDeviceContainer apDevices;
     apDevices = wifi.Install (phy, mac, wifiApNode);
+    ConfigureWifiPhyMode (mode);
 
     // mobility configuration
     MobilityHelper mobility;
@@ -289,9 +315,23 @@ int main (int argc, char *argv[])
                                  "GridWidth", UintegerValue (3),
                                  "LayoutType", StringValue ("RowFirst"));
 
-    mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
-    mobility.Install (wifiStaNodes);
+    if (!mobilityTrace.empty ())
+      {
+        InstallWaypointTrace (wifiStaNodes, mobilityTrace);
+      }
+    else
+      {
+        if (staticNodes)
+          {
+            mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+          }
+        else
+          {
+            mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                                     "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+          }
+        mobility.Install (wifiStaNodes);
+      }
 
     mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
     mobility.Install (wifiApNode);
@@ -336,14 +376,19 @@ int main (int argc, char *argv[])
 
     Simulator::Stop (Seconds (10.0));
 
+    // all devices of the channel in one file
+    Ptr<PcapngCapture> capture = Create<PcapngCapture> ();
     if (tracing == true)
     {
 //      pointToPoint.EnablePcapAll ("third");
 //      phy.EnablePcap ("third", apDevices.Get (0));
 //      csma.EnablePcap ("third", csmaDevices.Get (0), true);
+      NS_ABORT_MSG_IF (!capture->Open ("device1.pcapng"), "Cannot open device1.pcapng");
+      capture->AddDevices (apDevices, staDevices, pcapMode, pcapEvery);
     }
 
     Simulator::Run ();
     Simulator::Destroy ();
+    capture->Close ();
     return 0;
 }
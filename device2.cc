@@ -26,6 +26,10 @@
 #include "ns3/flow-monitor.h"
 #include "ns3/flow-monitor-helper.h"
 
+#include "cached-propagation-loss-model.h"
+#include "waypoint-trace-mobility-model.h"
+#include "wifi-phy-mode.h"
+
 
 // Default Network Topology
 //
@@ -211,13 +215,21 @@ main (int argc, char *argv[])
 
   uint32_t nWifi = 501;
   //bool tracing = true;
-
-//  CommandLine cmd;
-//  cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
-//  cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
-//  cmd.AddValue ("tracing", "Enable pcap tracing", tracing);
-
-//  cmd.Parse (argc,argv);
+  bool staticNodes = false;
+  std::string mobilityTrace;
+  std::string phyMode = "11a:0";
+
+  CommandLine cmd;
+  cmd.AddValue ("nWifi", "Number of wifi nodes, AP included", nWifi);
+  cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
+  cmd.AddValue ("staticNodes", "Fixed install: constant STA positions and cached path loss", staticNodes);
+  cmd.AddValue ("mobilityTrace", "Binary waypoint trace driving the STAs (see waypoint-trace-convert)", mobilityTrace);
+  cmd.AddValue ("phyMode", "Standard and MCS of all devices: 11a:0-7, 11n:0-7, 11ac:0-8 or 11ax:0-11", phyMode);
+  cmd.Parse (argc,argv);
+
+  NS_ABORT_MSG_IF (staticNodes && !mobilityTrace.empty (), "staticNodes and mobilityTrace are exclusive");
+  WifiPhyMode mode;
+  NS_ABORT_MSG_IF (!ParseWifiPhyMode (phyMode, mode), "Unknown phyMode " << phyMode);
 
   // Check for valid number of csma or wifi nodes
   // 250 should be enough, otherwise IP addresses 
@@ -259,10 +271,16 @@ main (int argc, char *argv[])
 
   YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
   YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
-  phy.SetChannel (channel.Create ());
+  Ptr<YansWifiChannel> wifiChannel = channel.Create ();
+  phy.SetChannel (wifiChannel);
+  if (staticNodes)
+    {
+      EnablePathLossCache (wifiChannel);
+    }
 
   WifiHelper wifi;
-  wifi.SetRemoteStationManager ("ns3::AarfWifiManager");
+  // Aarf has no HT rates, Minstrel takes over from 11n on
+  ApplyWifiPhyMode (wifi, mode, mode.standard == WIFI_PHY_STANDARD_80211a ? "ns3::AarfWifiManager" : "ns3::MinstrelHtWifiManager");
 
   WifiMacHelper mac;
   Ssid ssid = Ssid ("ns-3-ssid");
@@ -282,6 +300,7 @@ main (int argc, char *argv[])
   // Install AP device
   NetDeviceContainer apDevices;
   apDevices = wifi.Install (phy, mac, wifiApNode);
+  ConfigureWifiPhyMode (mode);
 
 
   // Mobility models
@@ -295,9 +314,23 @@ main (int argc, char *argv[])
                                  "GridWidth", UintegerValue (20),
                                  "LayoutType", StringValue ("RowFirst"));
 
-  mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (0,1000, 0, 1000)));
-  mobility.Install (wifiStaNodes);
+  if (!mobilityTrace.empty ())
+    {
+      InstallWaypointTrace (wifiStaNodes, mobilityTrace);
+    }
+  else
+    {
+      if (staticNodes)
+        {
+          mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+        }
+      else
+        {
+          mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                                     "Bounds", RectangleValue (Rectangle (0,1000, 0, 1000)));
+        }
+      mobility.Install (wifiStaNodes);
+    }
 
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
   mobility.Install (wifiApNode);
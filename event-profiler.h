@@ -0,0 +1,316 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_PROFILER_H
+#define EVENT_PROFILER_H
+
+#include "ns3/core-module.h"
+
+#include "simulation-heartbeat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * An event that carries the name of its handler for the profiler, see
+ * ScheduleNamed.
+ */
+class NamedEventImpl : public EventImpl
+{
+public:
+  NamedEventImpl (const char *name, EventImpl *event)
+    : m_name (name),
+      m_event (event, false)
+  {
+  }
+  const char *GetName (void) const
+  {
+    return m_name;
+  }
+
+protected:
+  virtual void Notify (void)
+  {
+    m_event->Invoke ();
+  }
+
+private:
+  const char *m_name;
+  Ptr<EventImpl> m_event;
+};
+
+/*
+ * MapScheduler that also measures how long each dispatched event ran.
+ * The simulator pulls the next event with RemoveNext right after the
+ * previous one returned, so the wall time between two RemoveNext calls is
+ * charged to the earlier event. Cancelled events never run and are not
+ * counted.
+ *
+ * Events scheduled with ScheduleNamed get one row per name, i.e. per
+ * handler. Anything else (ns-3's own events, plain Simulator::Schedule) is
+ * grouped by the dynamic type of its EventImpl, the MakeEvent
+ * instantiation: one row per target class and member function signature,
+ * since the bound function pointer is private to the EventImpl.
+ *
+ * Install with EnableEventProfiler() before Simulator::Run; the report,
+ * sorted by total wall time, is written from Simulator::Destroy. Derives
+ * from the heartbeat scheduler so both can be used together.
+ */
+class ProfilingMapScheduler : public HeartbeatMapScheduler
+{
+public:
+  static TypeId GetTypeId (void);
+  ProfilingMapScheduler ();
+  virtual ~ProfilingMapScheduler ();
+
+  virtual Scheduler::Event RemoveNext (void);
+
+  static void Report (void);
+  static std::string s_label;
+  static std::string s_path;
+  static bool s_enabled;
+
+private:
+  struct Stats
+  {
+    uint64_t count;
+    double seconds;
+  };
+  typedef std::chrono::steady_clock Clock;
+
+  void Charge (Clock::time_point now);
+  static std::string Describe (std::type_index type);
+
+  std::unordered_map<std::type_index, Stats> m_stats;
+  std::unordered_map<const char *, Stats> m_named;
+  std::type_index m_running;
+  const char *m_runningName;
+  bool m_hasRunning;
+  bool m_reported;
+  Clock::time_point m_started;
+
+  static ProfilingMapScheduler *s_current;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingMapScheduler);
+
+std::string ProfilingMapScheduler::s_label;
+std::string ProfilingMapScheduler::s_path;
+bool ProfilingMapScheduler::s_enabled = false;
+ProfilingMapScheduler *ProfilingMapScheduler::s_current = 0;
+
+TypeId
+ProfilingMapScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ProfilingMapScheduler")
+    .SetParent<HeartbeatMapScheduler> ()
+    .AddConstructor<ProfilingMapScheduler> ()
+  ;
+  return tid;
+}
+
+ProfilingMapScheduler::ProfilingMapScheduler ()
+  : m_running (typeid (void)),
+    m_runningName (0),
+    m_hasRunning (false),
+    m_reported (false)
+{
+  s_current = this;
+}
+
+ProfilingMapScheduler::~ProfilingMapScheduler ()
+{
+  if (s_current == this)
+    {
+      s_current = 0;
+    }
+}
+
+void
+ProfilingMapScheduler::Charge (Clock::time_point now)
+{
+  if (m_hasRunning)
+    {
+      Stats &stats = m_runningName != 0 ? m_named[m_runningName] : m_stats[m_running];
+      stats.count++;
+      stats.seconds += std::chrono::duration<double> (now - m_started).count ();
+    }
+  m_hasRunning = false;
+}
+
+Scheduler::Event
+ProfilingMapScheduler::RemoveNext (void)
+{
+  Scheduler::Event ev = HeartbeatMapScheduler::RemoveNext ();
+  if (m_reported)
+    {
+      // DoDispose draining the queue, nothing runs any more
+      return ev;
+    }
+  Clock::time_point now = Clock::now ();
+  Charge (now);
+  if (!ev.impl->IsCancelled ())
+    {
+      NamedEventImpl *named = dynamic_cast<NamedEventImpl *> (ev.impl);
+      m_runningName = named != 0 ? named->GetName () : 0;
+      m_running = std::type_index (typeid (*ev.impl));
+      m_hasRunning = true;
+      m_started = now;
+    }
+  return ev;
+}
+
+std::string
+ProfilingMapScheduler::Describe (std::type_index type)
+{
+  int status = 0;
+  char *demangled = abi::__cxa_demangle (type.name (), 0, 0, &status);
+  std::string name = status == 0 ? demangled : type.name ();
+  std::free (demangled);
+
+  // "ns3::MakeEvent<void (ns3::YansWifiPhy::*)(...), ns3::YansWifiPhy*>(...)::EventMemberImpl0"
+  // -> "void (ns3::YansWifiPhy::*)(...), ns3::YansWifiPhy*"
+  std::string::size_type begin = name.find ("MakeEvent<");
+  if (begin == std::string::npos)
+    {
+      return name;
+    }
+  begin += 10;
+  int depth = 1;
+  for (std::string::size_type i = begin; i < name.size (); i++)
+    {
+      if (name[i] == '<')
+        {
+          depth++;
+        }
+      else if (name[i] == '>' && --depth == 0)
+        {
+          return name.substr (begin, i - begin);
+        }
+    }
+  return name;
+}
+
+void
+ProfilingMapScheduler::Report (void)
+{
+  ProfilingMapScheduler *self = s_current;
+  if (self == 0 || self->m_reported)
+    {
+      return;
+    }
+  // the last dispatched event is the one that stopped the run; its interval
+  // would include everything between Run and Destroy, so drop it
+  self->m_hasRunning = false;
+  self->m_reported = true;
+  s_enabled = false;
+
+  std::vector< std::pair<double, std::string> > rows;
+  std::unordered_map<std::string, Stats> merged;
+  double total = 0;
+  uint64_t events = 0;
+  for (std::unordered_map<std::type_index, Stats>::const_iterator it = self->m_stats.begin ();
+       it != self->m_stats.end (); ++it)
+    {
+      Stats &row = merged[Describe (it->first)];
+      row.count += it->second.count;
+      row.seconds += it->second.seconds;
+      total += it->second.seconds;
+      events += it->second.count;
+    }
+  for (std::unordered_map<const char *, Stats>::const_iterator it = self->m_named.begin ();
+       it != self->m_named.end (); ++it)
+    {
+      Stats &row = merged[it->first];
+      row.count += it->second.count;
+      row.seconds += it->second.seconds;
+      total += it->second.seconds;
+      events += it->second.count;
+    }
+  for (std::unordered_map<std::string, Stats>::const_iterator it = merged.begin (); it != merged.end (); ++it)
+    {
+      rows.push_back (std::make_pair (it->second.seconds, it->first));
+    }
+  std::sort (rows.rbegin (), rows.rend ());
+
+  std::ofstream file;
+  if (!s_path.empty ())
+    {
+      file.open (s_path.c_str (), std::ios::app);
+    }
+  std::ostream &os = file.is_open () ? file : std::clog;
+  os << "=== event profile " << s_label << ": " << events << " events, "
+     << std::fixed << std::setprecision (3) << total << " s ===" << std::endl;
+  os << std::setw (12) << "count" << std::setw (12) << "total s" << std::setw (10) << "mean us"
+     << std::setw (8) << "share" << "  target" << std::endl;
+  for (uint32_t i = 0; i < rows.size (); i++)
+    {
+      const Stats &stats = merged[rows[i].second];
+      os << std::setw (12) << stats.count
+         << std::setw (12) << std::setprecision (3) << stats.seconds
+         << std::setw (10) << std::setprecision (2) << stats.seconds * 1e6 / stats.count
+         << std::setw (7) << std::setprecision (1) << (total > 0 ? 100 * stats.seconds / total : 0) << "%"
+         << "  " << rows[i].second << std::endl;
+    }
+}
+
+/*
+ * Swap in the profiling scheduler for the current simulation. Needs to be
+ * called again after every Simulator::Destroy.
+ */
+inline void
+EnableEventProfiler (std::string label, std::string path = "")
+{
+  ProfilingMapScheduler::s_label = label;
+  ProfilingMapScheduler::s_path = path;
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::ProfilingMapScheduler");
+  Simulator::SetScheduler (factory);
+  ProfilingMapScheduler::s_enabled = true;
+  Simulator::ScheduleDestroy (&ProfilingMapScheduler::Report);
+}
+
+/*
+ * Simulator::Schedule that gives the profiler a row per name rather than
+ * per member function signature. name must outlive the run (a literal).
+ * Without the profiler it is a plain Schedule, no wrapper event.
+ */
+template <typename MEM, typename OBJ, typename... Ts>
+EventId
+ScheduleNamed (const char *name, const Time &delay, MEM mem, OBJ obj, Ts... args)
+{
+  if (!ProfilingMapScheduler::s_enabled)
+    {
+      return Simulator::Schedule (delay, mem, obj, args...);
+    }
+  return Simulator::Schedule (delay, Ptr<EventImpl> (new NamedEventImpl (name, MakeEvent (mem, obj, args...)), false));
+}
+
+} // namespace ns3
+
+#endif /* EVENT_PROFILER_H */
@@ -0,0 +1,790 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// ID-based TDMA (apApp/staApp of idtdma-tests) against the timed CSMA
+// baseline (MyApp of idtdma-csma) on the same nWifi x Tcycle grid. Both
+// variants of a cell get the same seed and run, channel and PHY helpers,
+// rate manager, STA placement and mobility, packet size and packet count,
+// so the only difference is how the stations get onto the air:
+//
+//   tdma: association channel + ID request, the AP hands every STA its
+//         own ID; ID i sends i * Tcycle/nWifi after joining the data
+//         channel, then every Tcycle
+//   csma: one channel, every STA probes at start and sends from a fixed
+//         csmaSlotMs offset, then every Tcycle
+//
+// Results go to tdma-vs-csma.txt, one line per cell with both variants
+// side by side, and as "compare-tdma" / "compare-csma" records to the
+// sweep results file.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/internet-module.h"
+
+#include "cached-propagation-loss-model.h"
+#include "latency-probe.h"
+#include "run-resources.h"
+#include "sweep-results.h"
+#include "wifi-phy-mode.h"
+
+#include <string>
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("IdtdmaCompare");
+
+LatencyProbe g_latency;
+
+// ID server of idtdma-tests with the assignment of idtdma: the lowest free
+// ID, keyed on the STA MAC the request carries so a repeated request gets
+// the same ID back.
+class apApp : public Application
+{
+public:
+    void SetCycle(uint32_t Tcycle);
+private:
+
+    virtual void StartApplication (void);
+    virtual void StopApplication (void){}
+
+    Ptr<Socket> m_socket;
+
+    std::set<int> ids;
+    std::map<Mac48Address, int> m_assigned; // STA MAC -> id
+    uint32_t m_Tcycle;
+
+    void RequestId(Ptr<Socket> socket);
+};
+
+void apApp::StartApplication ()
+{
+    uint16_t apPort = 9996;
+    Address apAddress (InetSocketAddress (Ipv4Address::GetAny (), apPort));
+    m_socket=Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+    m_socket->SetRecvCallback (MakeCallback(&apApp::RequestId, this));
+    m_socket->Bind (apAddress);
+}
+
+void apApp::RequestId (Ptr<Socket> socket)
+{
+    Address addr;
+    Ptr<Packet> receivedPacket;
+    receivedPacket = socket->RecvFrom(addr);
+
+    uint8_t request[6] = {0};
+    receivedPacket->CopyData (request, 6);
+    Mac48Address sta;
+    sta.CopyFrom (request);
+
+    int id=1;
+    std::map<Mac48Address, int>::iterator assigned = m_assigned.find (sta);
+    if (assigned != m_assigned.end ())
+      {
+        id = assigned->second;
+      }
+    else
+      {
+        // get next id
+        while(ids.find(id)!=ids.end())
+        {
+            id++;
+        }
+        ids.insert (id);
+        m_assigned[sta] = id;
+      }
+
+    std::string sid=boost::lexical_cast<std::string>(id);
+    Ptr<Packet> packet = Create<Packet> ((const uint8_t*)sid.c_str (),sid.size());
+    socket->SendTo(packet,0,addr);
+}
+
+void apApp::SetCycle(uint32_t Tcycle)
+{
+    m_Tcycle=Tcycle;
+}
+
+
+// TDMA station, as in idtdma-tests
+class staApp : public Application
+{
+public:
+    staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1, uint32_t id,  uint32_t packetSize, uint32_t nPackets, uint32_t nWifi);
+    void SetSlotTime(double tslot);
+    void SetCycle (uint32_t Tcycle);
+
+private:
+    virtual void StartApplication (void);
+    virtual void StopApplication (void);
+
+    void ScheduleAssociation(int device);
+    void StartAssociation (int device);
+
+    void ScheduleRequestId();
+    void RequestId(); // funtion requesting id from AP
+    void UpdateId(Ptr<Socket> socket); // callback receiving id from AP
+
+    void SendPacket(void);
+    void ScheduleTx(void);
+
+    Ptr<Node> m_node;
+    std::vector< Ptr<Socket> > m_sockets;
+    Ipv4Address m_peer;
+    Ipv4Address m_peer1;
+    uint32_t m_packetSize;
+    uint32_t m_nPackets;
+    uint32_t m_packetsSent;
+    uint32_t m_id;
+    double m_tslot;
+    uint32_t m_nWifi;
+    EventId m_sendEvent;
+    bool m_running;
+    uint32_t m_Tcycle;
+
+    std::vector< Ptr<WifiNetDevice> > m_devices;
+    std::vector< Ptr<StaWifiMac> > m_macs;
+};
+
+staApp::staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1,uint32_t id, uint32_t packetSize, uint32_t nPackets, uint32_t nWifi)
+  : m_node(node),
+    m_peer(addr),
+    m_peer1(addr1),
+    m_packetSize(packetSize),
+    m_nPackets(nPackets),
+    m_packetsSent(0),
+    m_id(id),
+    m_tslot(0),
+    m_nWifi(nWifi),
+    m_sendEvent(),
+    m_running(false)
+{
+    m_devices.push_back( StaticCast<WifiNetDevice>(m_node->GetDevice(0)) );
+    m_devices.push_back( StaticCast<WifiNetDevice>(m_node->GetDevice(1)) );
+    m_macs.push_back (StaticCast<StaWifiMac>(m_devices[0]->GetMac()));
+    m_macs.push_back (StaticCast<StaWifiMac>(m_devices[1]->GetMac()));
+
+    m_macs[0]->SetLinkUpCallback (MakeCallback(&staApp::ScheduleRequestId,this)); // setup callback for requesting id
+
+    Ipv4Address staIpv4Address0=m_node->GetObject<Ipv4>()->GetAddress(1,0).GetLocal();
+    uint16_t staPort = 9996;
+    Address staAddress0 (InetSocketAddress (staIpv4Address0, staPort));
+    m_sockets.push_back(Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ()));
+
+    m_sockets[0]->SetRecvCallback(MakeCallback(&staApp::UpdateId,this));
+    m_sockets[0]->Bind(staAddress0);
+
+    m_macs[1]->SetLinkUpCallback (MakeCallback(&staApp::ScheduleTx,this));
+    Ipv4Address staIpv4Address1=m_node->GetObject<Ipv4>()->GetAddress (2,0).GetLocal();
+    staPort = 9998;
+    Address staAddress1 (InetSocketAddress (staIpv4Address1, staPort));
+    m_sockets.push_back (Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ()));
+    m_sockets[1]->Bind (staAddress1);
+}
+
+void
+staApp::StartApplication (void)
+{
+    ScheduleAssociation (0);
+}
+
+void
+staApp::StopApplication (void)
+{
+    m_running = false;
+    if (m_sendEvent.IsRunning ())
+    {
+        Simulator::Cancel (m_sendEvent);
+    }
+}
+
+void staApp::StartAssociation (int device)
+{
+    m_macs[device]->SetAttribute ("ActiveProbing",BooleanValue(true));
+}
+
+void staApp::ScheduleAssociation (int device)
+{
+  double ts_ms = 1000*m_tslot;
+  Simulator::Schedule (MilliSeconds(m_id*ts_ms), &staApp::StartAssociation, this,device);
+}
+
+void staApp::ScheduleRequestId()
+{
+  double ts_ms = 1000*m_tslot;
+  Simulator::Schedule (MilliSeconds(m_id*ts_ms), &staApp::RequestId, this);
+}
+
+void staApp::RequestId ()
+{
+    // the AP keys the assignment on our MAC
+    uint8_t request[64] = {0};
+    Mac48Address::ConvertFrom (m_devices[0]->GetAddress ()).CopyTo (request);
+    Ptr<Packet> packet = Create<Packet> (request, 64);
+    uint16_t apPort = 9996;
+    Address apAddress (InetSocketAddress (m_peer, apPort));
+    m_sockets[0]->SendTo(packet,0,apAddress);
+}
+
+void staApp::UpdateId(Ptr<Socket> socket)
+{
+  Ptr<Packet> packet=socket->Recv ();
+  std::ostringstream ostr;
+  packet->CopyData(&ostr, packet->GetSize());
+  m_id=boost::lexical_cast<uint32_t>(ostr.str ());
+  // once id is updated, start association on second device
+  ScheduleAssociation (1);
+}
+
+void staApp::ScheduleTx (void)
+{
+  if (m_packetsSent==0)
+      {
+          double ts_ms = 1000*m_tslot;
+          Time tNext =MilliSeconds(m_id*ts_ms );
+          m_sendEvent = Simulator::Schedule (tNext, &staApp::SendPacket,this);
+      }
+  else
+      {
+          Time tNext(Seconds(m_Tcycle ));
+          m_sendEvent = Simulator::Schedule (tNext, &staApp::SendPacket,this);
+      }
+}
+
+void staApp::SendPacket (void)
+{
+    Ptr<Packet> packet = Create<Packet> (m_packetSize);
+    uint16_t apPort = 9998;
+    Address apAddress (InetSocketAddress (m_peer1, apPort));
+    g_latency.Stamp (packet);
+    m_sockets[1]->SendTo(packet,0,apAddress);
+    if (++m_packetsSent<m_nPackets)
+    {
+        ScheduleTx ();
+    }
+}
+
+void staApp::SetSlotTime (double tslot)
+{
+  m_tslot = tslot;
+}
+
+void staApp::SetCycle (uint32_t Tcycle)
+{
+    m_Tcycle=Tcycle;
+}
+
+
+// Timed CSMA station, as in idtdma-csma; the period between packets is the
+// cell's Tcycle instead of the fixed 10 s there.
+class MyApp : public Application
+{
+public:
+    MyApp (Ptr<Node> node, int id);
+    virtual ~MyApp();
+    void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, Time period);
+    void SetSlotTime(uint32_t tslot);
+
+private:
+    virtual void StartApplication (void);
+    virtual void StopApplication (void);
+
+    void ScheduleAssociation(void);
+    void StartAssociation (void);
+    void SendPacketTimed (void);
+    void ScheduleTx(void);
+
+    Ptr<Socket>     m_socket;
+    Address         m_peer;
+    uint32_t        m_packetSize;
+    uint32_t        m_nPackets;
+    Time            m_period;
+    uint32_t        m_packetsSent;
+    Ptr<Node> m_node;
+    uint32_t m_id;
+    uint32_t m_tslot;
+    EventId m_sendEvent;
+    bool m_running;
+};
+
+MyApp::MyApp (Ptr<Node> node, int id)
+  : m_peer (),
+    m_packetSize (0),
+    m_nPackets (1),
+    m_period (Seconds (10)),
+    m_packetsSent (0),
+    m_node(node),
+    m_id(id),
+    m_tslot(0),
+    m_sendEvent (),
+    m_running (false)
+{
+}
+
+MyApp::~MyApp()
+{
+}
+
+void
+MyApp::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, Time period)
+{
+  m_socket = socket;
+  m_peer = address;
+  m_packetSize = packetSize;
+  m_nPackets = nPackets;
+  m_period = period;
+}
+
+void
+MyApp::StartApplication (void)
+{
+    m_running = true;
+    m_packetsSent = 0;
+    ScheduleAssociation ();
+    Time tstart = MilliSeconds(m_id*m_tslot);
+    m_sendEvent = Simulator::Schedule(tstart,&MyApp::SendPacketTimed,this);
+}
+
+void
+MyApp::StopApplication (void)
+{
+    m_running = false;
+
+    if (m_sendEvent.IsRunning ())
+    {
+        Simulator::Cancel (m_sendEvent);
+    }
+
+    if (m_socket)
+      {
+        m_socket->Close ();
+      }
+}
+
+void
+MyApp::SetSlotTime (uint32_t tslot)
+{
+  m_tslot = tslot;
+}
+
+void
+MyApp::StartAssociation (void)
+{
+    Ptr<WifiNetDevice> device = StaticCast<WifiNetDevice>(m_node->GetDevice(0));
+    Ptr<StaWifiMac> mac = StaticCast<StaWifiMac>(device->GetMac());
+    mac->SetAttribute ("ActiveProbing",BooleanValue(true));
+}
+
+void
+MyApp::ScheduleAssociation (void)
+{
+    if (m_running)
+    {
+        Simulator::ScheduleNow (&MyApp::StartAssociation, this);
+    }
+}
+
+void
+MyApp::ScheduleTx (void)
+{
+    if (m_running)
+    {
+        m_sendEvent = Simulator::Schedule (m_period, &MyApp::SendPacketTimed,this);
+    }
+}
+
+void
+MyApp::SendPacketTimed (void)
+{
+  Ptr<Packet> packet = Create<Packet> (m_packetSize);
+  m_socket->Bind ();
+  g_latency.Stamp (packet);
+  m_socket->SendTo(packet,0,m_peer);
+
+  if (++m_packetsSent<m_nPackets)
+    {
+      ScheduleTx ();
+    }
+}
+
+
+// Everything both variants of a cell share
+struct CompareSettings
+{
+  uint32_t packetSize;
+  uint32_t nPackets;
+  std::string rateManager;
+  WifiPhyMode phyMode;
+  bool staticNodes;
+  double stopTime;
+  uint32_t csmaSlotMs;
+};
+
+// Both variants assign explicit streams from 0, mobility first, so the
+// STAs walk the same paths in both; returns the streams used
+static int64_t
+InstallMobility (NodeContainer staNodes, NodeContainer apNode, const CompareSettings &settings)
+{
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                 "MinX", DoubleValue (0.0),
+                                 "MinY", DoubleValue (0.0),
+                                 "DeltaX", DoubleValue (0.5),
+                                 "DeltaY", DoubleValue (0.5),
+                                 "GridWidth", UintegerValue (20),
+                                 "LayoutType", StringValue ("RowFirst"));
+  if (settings.staticNodes)
+    {
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+    }
+  else
+    {
+      mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                                 "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+    }
+  mobility.Install (staNodes);
+
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (apNode);
+  return mobility.AssignStreams (staNodes, 0);
+}
+
+static Ptr<YansWifiChannel>
+CreateChannel (YansWifiPhyHelper &phy, uint32_t channelNumber, const CompareSettings &settings)
+{
+  YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
+  Ptr<YansWifiChannel> channel = channelHelper.Create ();
+  phy.SetChannel (channel);
+  phy.Set ("ChannelNumber", UintegerValue (channelNumber));
+  if (settings.staticNodes)
+    {
+      EnablePathLossCache (channel);
+    }
+  return channel;
+}
+
+/*
+ * Same seed and run for both variants of a cell, one run per cell. The
+ * automatic stream numbers come from a counter that keeps running across
+ * Simulator::Destroy, so the seed alone would not pair the variants: every
+ * random object also has to be on an explicit stream (AssignStreams).
+ */
+static void
+SeedVariant (uint32_t seed, uint32_t nWifi, uint32_t Tcycle)
+{
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (nWifi * 1000 + Tcycle);
+}
+
+// Runs the built scenario and fills in the record
+static void
+RunCell (ResourceMeter &meter, SweepRecord &r)
+{
+  meter.SetupDone ();
+  Simulator::Run ();
+  Simulator::Destroy ();
+  RunResources cost = meter.Stop (0);
+
+  r.sent = g_latency.GetSent ();
+  r.delivered = g_latency.GetDelivered ();
+  r.drops = g_latency.GetDropped ();
+  r.deliveryRatio = r.sent > 0 ? (double)r.delivered / r.sent : 0;
+  r.dropRate = r.sent > 0 ? (double)r.drops / r.sent : 0;
+  r.latencyP50Ms = g_latency.GetPercentileMs (0.5);
+  r.latencyP90Ms = g_latency.GetPercentileMs (0.9);
+  r.latencyP99Ms = g_latency.GetPercentileMs (0.99);
+  r.latencyMaxMs = g_latency.GetPercentileMs (1);
+  r.wallS = cost.setupWallS + cost.runWallS;
+}
+
+static SweepRecord
+RunTdma (uint32_t nWifi, uint32_t Tcycle, const CompareSettings &settings)
+{
+  ResourceMeter meter;
+  meter.Start ();
+  g_latency.Reset ();
+
+  NodeContainer wifiStaNodes;
+  wifiStaNodes.Create (nWifi);
+  NodeContainer wifiApNode;
+  wifiApNode.Create (1);
+
+  YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+  Ptr<YansWifiChannel> assocChannel = CreateChannel (phy, 0, settings);
+  YansWifiPhyHelper phy1 = YansWifiPhyHelper::Default ();
+  Ptr<YansWifiChannel> dataChannel = CreateChannel (phy1, 1, settings);
+
+  WifiHelper wifi;
+  ApplyWifiPhyMode (wifi, settings.phyMode, settings.rateManager);
+
+  WifiMacHelper mac;
+  Ssid ssid = Ssid ("ns-3-ssid");
+  mac.SetType ("ns3::StaWifiMac","Ssid", SsidValue (ssid),"ActiveProbing", BooleanValue (false));
+  NetDeviceContainer staDevices0 = wifi.Install (phy, mac, wifiStaNodes);
+  NetDeviceContainer staDevices1 = wifi.Install (phy1, mac, wifiStaNodes);
+
+  mac.SetType ("ns3::ApWifiMac","Ssid", SsidValue (ssid),"BeaconGeneration", BooleanValue(false),"BeaconInterval", TimeValue(Days(1)));
+  NetDeviceContainer apDevices = wifi.Install (phy, mac, wifiApNode);
+  NetDeviceContainer apDevices1 = wifi.Install (phy1, mac, wifiApNode);
+  ConfigureWifiPhyMode (settings.phyMode);
+
+  int64_t stream = InstallMobility (wifiStaNodes, wifiApNode, settings);
+
+  InternetStackHelper stack;
+  stack.Install (wifiApNode);
+  stack.Install (wifiStaNodes);
+
+  stream += dataChannel->AssignStreams (stream);
+  stream += assocChannel->AssignStreams (stream);
+  stream += wifi.AssignStreams (staDevices1, stream);
+  stream += wifi.AssignStreams (apDevices1, stream);
+  stream += wifi.AssignStreams (staDevices0, stream);
+  stream += wifi.AssignStreams (apDevices, stream);
+  stream += stack.AssignStreams (wifiStaNodes, stream);
+  stream += stack.AssignStreams (wifiApNode, stream);
+
+  Ipv4AddressHelper address;
+  address.SetBase ("192.168.0.0", "255.255.248.0");
+  Ipv4InterfaceContainer apInterface = address.Assign (apDevices);
+  address.Assign (staDevices0);
+  address.SetBase ("10.1.0.0", "255.255.248.0");
+  Ipv4InterfaceContainer apInterface1 = address.Assign (apDevices1);
+  address.Assign (staDevices1);
+
+  Ptr<apApp> apApp1 = CreateObject<apApp> ();
+  apApp1->SetCycle (Tcycle);
+  wifiApNode.Get (0)->AddApplication (apApp1);
+  apApp1->SetStartTime (Seconds (0));
+  apApp1->SetStopTime (Seconds (settings.stopTime - 1));
+
+  uint16_t sinkPort = 9998;
+  PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (apInterface1.GetAddress (0), sinkPort));
+  ApplicationContainer sinkApps = packetSinkHelper.Install (wifiApNode.Get (0));
+  sinkApps.Start (Seconds (0));
+  sinkApps.Stop (Seconds (settings.stopTime));
+  g_latency.Attach (sinkApps.Get (0));
+
+  Ptr<WifiPhy> apPhy = StaticCast<WifiNetDevice> (apDevices1.Get (0))->GetPhy ();
+  g_latency.AttachDrops (apPhy);
+
+  for (uint32_t k=0; k<nWifi; k++)
+    {
+      Ptr<staApp> app1 = CreateObject<staApp> (wifiStaNodes.Get (k), apInterface.GetAddress(0), apInterface1.GetAddress(0), k, settings.packetSize, settings.nPackets, nWifi);
+      app1->SetCycle (Tcycle);
+      wifiStaNodes.Get (k)->AddApplication (app1);
+      app1->SetSlotTime ((double)Tcycle/nWifi);
+      app1->SetStartTime (MilliSeconds (1000));
+      app1->SetStopTime (Seconds (settings.stopTime - 1));
+    }
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Stop (Seconds (settings.stopTime));
+
+  SweepRecord r;
+  SweepRecordInit (r, "compare-tdma");
+  RunCell (meter, r);
+  r.rxBytes = DynamicCast<PacketSink> (sinkApps.Get (0))->GetTotalRx ();
+  return r;
+}
+
+static SweepRecord
+RunCsma (uint32_t nWifi, uint32_t Tcycle, const CompareSettings &settings)
+{
+  ResourceMeter meter;
+  meter.Start ();
+  g_latency.Reset ();
+
+  NodeContainer wifiStaNodes;
+  wifiStaNodes.Create (nWifi);
+  NodeContainer wifiApNode;
+  wifiApNode.Create (1);
+
+  // the TDMA data channel
+  YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+  Ptr<YansWifiChannel> channel = CreateChannel (phy, 1, settings);
+
+  WifiHelper wifi;
+  ApplyWifiPhyMode (wifi, settings.phyMode, settings.rateManager);
+
+  WifiMacHelper mac;
+  Ssid ssid = Ssid ("ns-3-ssid");
+  mac.SetType ("ns3::StaWifiMac",
+               "Ssid", SsidValue (ssid),
+               "ActiveProbing", BooleanValue (false),"MaxMissedBeacons",UintegerValue(1000));
+  NetDeviceContainer staDevices = wifi.Install (phy, mac, wifiStaNodes);
+
+  mac.SetType ("ns3::ApWifiMac",
+               "Ssid", SsidValue (ssid),
+               "BeaconGeneration", BooleanValue(false),"BeaconInterval",TimeValue(Days(1)));
+  NetDeviceContainer apDevices = wifi.Install (phy, mac, wifiApNode);
+  ConfigureWifiPhyMode (settings.phyMode);
+
+  int64_t stream = InstallMobility (wifiStaNodes, wifiApNode, settings);
+
+  InternetStackHelper stack;
+  stack.Install (wifiApNode);
+  stack.Install (wifiStaNodes);
+
+  // the data channel's streams line up with the TDMA data channel's
+  stream += channel->AssignStreams (stream);
+  stream += wifi.AssignStreams (staDevices, stream);
+  stream += wifi.AssignStreams (apDevices, stream);
+  stream += stack.AssignStreams (wifiStaNodes, stream);
+  stream += stack.AssignStreams (wifiApNode, stream);
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.0.0", "255.255.248.0");
+  Ipv4InterfaceContainer apInterface = address.Assign (apDevices);
+  address.Assign (staDevices);
+
+  uint16_t sinkPort = 9998;
+  Address sinkAddress (InetSocketAddress (apInterface.GetAddress (0), sinkPort));
+  PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkAddress);
+  ApplicationContainer sinkApps = packetSinkHelper.Install (wifiApNode.Get (0));
+  sinkApps.Start (Seconds (0));
+  sinkApps.Stop (Seconds (settings.stopTime));
+  g_latency.Attach (sinkApps.Get (0));
+
+  Ptr<WifiPhy> apPhy = StaticCast<WifiNetDevice> (apDevices.Get (0))->GetPhy ();
+  g_latency.AttachDrops (apPhy);
+
+  for (uint32_t k=0; k<nWifi; k++)
+    {
+      Ptr<Socket> ns3UdpSocket = Socket::CreateSocket (wifiStaNodes.Get (k), UdpSocketFactory::GetTypeId ());
+      Ptr<MyApp> app1 = CreateObject<MyApp> (wifiStaNodes.Get (k), k+1);
+      app1->Setup (ns3UdpSocket, sinkAddress, settings.packetSize, settings.nPackets, Seconds (Tcycle));
+      wifiStaNodes.Get (k)->AddApplication (app1);
+      app1->SetSlotTime (settings.csmaSlotMs);
+      app1->SetStartTime (Seconds (1));
+      app1->SetStopTime (Seconds (settings.stopTime - 1));
+    }
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Simulator::Stop (Seconds (settings.stopTime));
+
+  SweepRecord r;
+  SweepRecordInit (r, "compare-csma");
+  RunCell (meter, r);
+  r.rxBytes = DynamicCast<PacketSink> (sinkApps.Get (0))->GetTotalRx ();
+  return r;
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t nWifi[20];
+    for (int i=0; i<20; i++)
+      {
+        nWifi[i]= 100+100*i;
+      }
+
+    uint32_t Tcycle[] = {1,5,10,30,60};
+
+    CompareSettings settings;
+    settings.packetSize = 200;
+    settings.nPackets = 2;
+    settings.rateManager = "";
+    settings.staticNodes = false;
+    settings.stopTime = 201;
+    settings.csmaSlotMs = 5;
+    uint32_t maxWifi = 2000;
+    uint32_t seed = 1;
+    uint32_t nSeeds = 1;
+    std::string outFile = "tdma-vs-csma.txt";
+    std::string resultsFile = "sweep-results.bin";
+    std::string phyMode = "11a:0";
+
+    CommandLine cmd;
+    cmd.AddValue ("packetSize", "STA data packet size in bytes", settings.packetSize);
+    cmd.AddValue ("nPackets", "Data packets per STA, one per Tcycle", settings.nPackets);
+    cmd.AddValue ("rateManager", "Remote station manager of all devices (default: Aarf for 11a, MinstrelHt above)", settings.rateManager);
+    cmd.AddValue ("phyMode", "Standard and MCS of all devices: 11a:0-7, 11n:0-7, 11ac:0-8 or 11ax:0-11", phyMode);
+    cmd.AddValue ("staticNodes", "Fixed install: constant STA positions and cached path loss", settings.staticNodes);
+    cmd.AddValue ("stopTime", "Simulated seconds per run", settings.stopTime);
+    cmd.AddValue ("csmaSlotMs", "CSMA: first packet of STA k goes out k*csmaSlotMs after start", settings.csmaSlotMs);
+    cmd.AddValue ("maxWifi", "Skip grid rows with more STAs than this", maxWifi);
+    cmd.AddValue ("seed", "First RNG seed", seed);
+    cmd.AddValue ("nSeeds", "Seeds per cell, seed .. seed+nSeeds-1", nSeeds);
+    cmd.AddValue ("outFile", "Side-by-side comparison table", outFile);
+    cmd.AddValue ("resultsFile", "Columnar results of every run, appended to; empty to disable", resultsFile);
+    cmd.Parse (argc,argv);
+    NS_ABORT_MSG_IF (!ParseWifiPhyMode (phyMode, settings.phyMode), "Unknown phyMode " << phyMode);
+    if (settings.rateManager.empty ())
+      {
+        settings.rateManager = DefaultRateManager (settings.phyMode);
+      }
+    // the mode's MCS is only the data rate when nothing adapts it
+    bool fixedRate = settings.rateManager == "ns3::ConstantRateWifiManager";
+    const SlotPhy &slot = settings.phyMode.slot;
+
+    SweepResultsWriter sweepResults;
+    if (!resultsFile.empty () && !sweepResults.Open (resultsFile))
+      {
+        NS_FATAL_ERROR ("Cannot append to results file " << resultsFile);
+      }
+
+    std::ofstream ofs (outFile.c_str ());
+    ofs << "# nWifi Tcycle seed"
+        << " tdma_delivery csma_delivery tdma_drop csma_drop"
+        << " tdma_p50_ms csma_p50_ms tdma_p99_ms csma_p99_ms" << std::endl;
+
+for (int i=0; i<20 && nWifi[i]<=maxWifi; i++)
+{
+        for (int j=0; j<5; j++)
+            {
+                for (uint32_t s=seed; s<seed+nSeeds; s++)
+                  {
+                    SeedVariant (s, nWifi[i], Tcycle[j]);
+                    SweepRecord tdma = RunTdma (nWifi[i], Tcycle[j], settings);
+                    SeedVariant (s, nWifi[i], Tcycle[j]);
+                    SweepRecord csma = RunCsma (nWifi[i], Tcycle[j], settings);
+
+                    SweepRecord *both[] = {&tdma, &csma};
+                    for (uint32_t v=0; v<2; v++)
+                      {
+                        both[v]->nWifi = nWifi[i];
+                        both[v]->Tcycle = Tcycle[j];
+                        both[v]->seed = s;
+                        both[v]->packetSize = settings.packetSize;
+                        std::strncpy (both[v]->phyMode, phyMode.c_str (), sizeof (both[v]->phyMode) - 1);
+                        if (fixedRate)
+                          {
+                            both[v]->slotCeiling = Tcycle[j] / (SlotAirtimeSeconds (slot, settings.packetSize) + SlotGuardSeconds (slot));
+                          }
+                        sweepResults.Add (*both[v]);
+                      }
+
+                    std::cout<< "nWifi="<<nWifi[i]<< " Tc="<<Tcycle[j]<<" seed="<<s
+                             <<" delivery tdma "<<tdma.deliveryRatio<<" csma "<<csma.deliveryRatio<<std::endl;
+                    ofs << nWifi[i] << " " << Tcycle[j] << " " << s << std::fixed << std::setprecision (4)
+                        << " " << tdma.deliveryRatio << " " << csma.deliveryRatio
+                        << " " << tdma.dropRate << " " << csma.dropRate
+                        << " " << tdma.latencyP50Ms << " " << csma.latencyP50Ms
+                        << " " << tdma.latencyP99Ms << " " << csma.latencyP99Ms
+                        << std::endl;
+                  }
+            }
+        sweepResults.Flush ();
+    }
+    ofs.close ();
+    sweepResults.Close ();
+    return 0;
+}
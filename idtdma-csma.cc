@@ -26,6 +26,9 @@
 #include "ns3/flow-monitor.h"
 #include "ns3/flow-monitor-helper.h"
 
+#include "cached-propagation-loss-model.h"
+#include "pcapng-capture.h"
+
 
 // Default Network Topology
 //
@@ -208,6 +211,18 @@ int
 main (int argc, char *argv[])
 {
   uint32_t nWifi = 101;
+  bool staticNodes = false;
+  std::string pcapFile;
+  std::string pcapMode = "ap";
+  uint32_t pcapEvery = 10;
+
+  CommandLine cmd;
+  cmd.AddValue ("nWifi", "Number of wifi nodes, AP included", nWifi);
+  cmd.AddValue ("staticNodes", "Fixed install: constant STA positions and cached path loss", staticNodes);
+  cmd.AddValue ("pcapFile", "Merged pcapng capture of the channel, empty to disable", pcapFile);
+  cmd.AddValue ("pcapMode", "Devices in the capture: all, ap or sample", pcapMode);
+  cmd.AddValue ("pcapEvery", "With pcapMode=sample, capture every n-th station", pcapEvery);
+  cmd.Parse (argc,argv);
 
   ns3::PacketMetadata::Enable();
 
@@ -222,7 +237,12 @@ main (int argc, char *argv[])
 
   YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
   YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
-  phy.SetChannel (channel.Create ());
+  Ptr<YansWifiChannel> wifiChannel = channel.Create ();
+  phy.SetChannel (wifiChannel);
+  if (staticNodes)
+    {
+      EnablePathLossCache (wifiChannel);
+    }
 
   WifiHelper wifi;
   wifi.SetRemoteStationManager ("ns3::AarfWifiManager");
@@ -258,8 +278,15 @@ main (int argc, char *argv[])
                                  "GridWidth", UintegerValue (1),
                                  "LayoutType", StringValue ("RowFirst"));
 
-  mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-100, 100, -100, 100)));
+  if (staticNodes)
+    {
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+    }
+  else
+    {
+      mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                                 "Bounds", RectangleValue (Rectangle (-100, 100, -100, 100)));
+    }
   mobility.Install (wifiStaNodes);
 
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
@@ -340,6 +367,12 @@ main (int argc, char *argv[])
 //        //      phy.EnablePcap ("third", apDevices.Get (0));
 //        //      csma.EnablePcap ("third", csmaDevices.Get (0), true);
 //      }
+    Ptr<PcapngCapture> capture = Create<PcapngCapture> ();
+    if (!pcapFile.empty ())
+      {
+        NS_ABORT_MSG_IF (!capture->Open (pcapFile), "Cannot open " << pcapFile);
+        capture->AddDevices (apDevices, staDevices, pcapMode, pcapEvery);
+      }
 
     // Flow monitor
     Ptr<FlowMonitor> flowmonitor;
@@ -348,6 +381,7 @@ main (int argc, char *argv[])
 
     Simulator::Run ();
     Simulator::Destroy ();
+    capture->Close ();
 
     uint64_t totalPacketsThrough = DynamicCast<PacketSink> (sinkApps.Get(0))->GetTotalRx ();
     std::cout<< std::endl<<totalPacketsThrough<<std::endl;
@@ -0,0 +1,743 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// ID-based TDMA past one AP: nAps APs on a grid of gridWidth columns,
+// apSpacing apart, nWifi STAs spread uniformly over the grid area.
+//
+//   cells:    every AP is a cell with its own SSID, subnet and ID space;
+//             STA k of a cell sends in slot k of every Tcycle
+//   channels: cells use nChannels data channels in a tiled reuse pattern,
+//             cells on the same channel share one YansWifiChannel and so
+//             interfere, different channels never do
+//   joining:  each STA takes the AP with the best predicted rx power,
+//             less loadPenaltyDb for every full cycle of slots the cell
+//             already has, in STA order
+//   slots:    by default a cell numbers its STAs 1, 2, ...; with slotReuse
+//             the STAs of all cells on a channel are colored instead, so
+//             STAs that cannot spoil each other at their own APs share a
+//             slot, in their cell or across co-channel cells
+//
+// The join protocol of idtdma (association channel, ID requests) is left
+// out: the plan hands out the IDs, so the runs measure the data side at
+// scale. Results per cell go to stdout and outFile.
+//
+// Cells on different channels share nothing, so with jobs > 1 the program
+// splits the channels over that many copies of itself (--channels=...),
+// each simulating only its cells, and merges their cell files into
+// outFile. The plan is the same in every copy; the per-device RNG streams
+// are not, so merged numbers match a single process statistically, not
+// bit for bit.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/internet-module.h"
+
+#include "cached-propagation-loss-model.h"
+#include "latency-probe.h"
+#include "run-resources.h"
+#include "slot-coloring.h"
+#include "wifi-phy-mode.h"
+
+#include <string>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("IdtdmaMultiAp");
+
+// Data side of staApp in idtdma: associate with the cell AP, then send in
+// slot m_id of every cycle on the grid that starts at time zero.
+class staApp : public Application
+{
+public:
+    staApp (Ptr<Node> node, Ipv4Address addr, uint32_t id, uint32_t packetSize, uint32_t nPackets, LatencyProbe *probe);
+    void SetSlotTime(double tslot);
+    void SetCycle (uint32_t Tcycle);
+
+private:
+    virtual void StartApplication (void);
+    virtual void StopApplication (void);
+
+    void ScheduleTx(void);
+    void SendPacket(void);
+
+    Ptr<Node> m_node;
+    Ptr<Socket> m_socket;
+    Ipv4Address m_peer;
+    uint32_t m_id;
+    uint32_t m_packetSize;
+    uint32_t m_nPackets;
+    uint32_t m_packetsSent;
+    double m_tslot;
+    uint32_t m_Tcycle;
+    EventId m_sendEvent;
+    LatencyProbe *m_probe;
+};
+
+staApp::staApp (Ptr<Node> node, Ipv4Address addr, uint32_t id, uint32_t packetSize, uint32_t nPackets, LatencyProbe *probe)
+  : m_node(node),
+    m_peer(addr),
+    m_id(id),
+    m_packetSize(packetSize),
+    m_nPackets(nPackets),
+    m_packetsSent(0),
+    m_tslot(0),
+    m_Tcycle(10),
+    m_probe(probe)
+{
+    Ptr<WifiNetDevice> device = StaticCast<WifiNetDevice>(m_node->GetDevice(0));
+    StaticCast<StaWifiMac>(device->GetMac())->SetLinkUpCallback (MakeCallback(&staApp::ScheduleTx,this));
+}
+
+void
+staApp::StartApplication (void)
+{
+    m_socket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+    m_socket->Bind ();
+    Ptr<WifiNetDevice> device = StaticCast<WifiNetDevice>(m_node->GetDevice(0));
+    StaticCast<StaWifiMac>(device->GetMac())->SetAttribute ("ActiveProbing",BooleanValue(true));
+}
+
+void
+staApp::StopApplication (void)
+{
+    Simulator::Cancel (m_sendEvent);
+    if (m_socket)
+      {
+        m_socket->Close ();
+      }
+}
+
+void staApp::ScheduleTx (void)
+{
+    if (m_sendEvent.IsRunning () || m_packetsSent >= m_nPackets)
+      {
+        return;
+      }
+    int64_t length = Seconds (m_Tcycle).GetTimeStep ();
+    int64_t offset = MilliSeconds (m_id*m_tslot).GetTimeStep () % length;
+    int64_t now = Simulator::Now ().GetTimeStep ();
+    int64_t target = (now / length) * length + offset;
+    if (target <= now)
+      {
+        target += length;
+      }
+    m_sendEvent = Simulator::Schedule (TimeStep (target - now), &staApp::SendPacket, this);
+}
+
+void staApp::SendPacket (void)
+{
+    Ptr<Packet> packet = Create<Packet> (m_packetSize);
+    m_probe->Stamp (packet);
+    m_socket->SendTo (packet, 0, InetSocketAddress (m_peer, 9998));
+    m_packetsSent++;
+    ScheduleTx ();
+}
+
+void staApp::SetSlotTime (double tslot)
+{
+  m_tslot = tslot;
+}
+
+void staApp::SetCycle (uint32_t Tcycle)
+{
+    m_Tcycle=Tcycle;
+}
+
+
+struct MultiApSettings
+{
+  uint32_t nAps;
+  uint32_t gridWidth;
+  double apSpacing;
+  uint32_t nChannels;
+  uint32_t Tcycle;
+  double tslot;          // ms
+  uint32_t packetSize;
+  uint32_t nPackets;
+  double loadPenaltyDb;
+  std::string rateManager;
+  WifiPhyMode phyMode;
+  bool pathLossCache;
+  double stopTime;
+  bool slotReuse;
+};
+
+struct StationPlan
+{
+  double x;
+  double y;
+  uint32_t cell;
+  uint32_t id;
+};
+
+struct CellResult
+{
+  uint32_t cell;
+  uint32_t channel;
+  uint32_t stations;
+  uint32_t overflow;     // STAs whose ID is past the cycle's slots
+  uint64_t sent;
+  uint64_t delivered;
+  uint64_t drops;        // the cell's data packets its AP dropped and never got
+  uint64_t rxBytes;
+  double latencyP50Ms;
+  double latencyP99Ms;
+};
+
+// Tiled reuse: neighbours left/right and up/down never share a channel
+static uint32_t
+CellChannel (uint32_t cell, const MultiApSettings &settings)
+{
+  uint32_t row = cell / settings.gridWidth, col = cell % settings.gridWidth;
+  return (col + row * ((settings.nChannels + 1) / 2)) % settings.nChannels;
+}
+
+static Vector
+ApPosition (uint32_t cell, const MultiApSettings &settings)
+{
+  return Vector ((cell % settings.gridWidth + 0.5) * settings.apSpacing,
+                 (cell / settings.gridWidth + 0.5) * settings.apSpacing, 0);
+}
+
+static uint32_t
+SlotsPerCycle (const MultiApSettings &settings)
+{
+  // slot 0 is never handed out
+  return std::max (1.0, settings.Tcycle * 1000 / settings.tslot - 1);
+}
+
+// Positions and AP choice of every STA. Draws from its own RNG stream, so
+// it only depends on the seed, not on what else the run creates.
+static std::vector<StationPlan>
+PlanDeployment (uint32_t nWifi, const MultiApSettings &settings)
+{
+  uint32_t rows = (settings.nAps + settings.gridWidth - 1) / settings.gridWidth;
+  Ptr<UniformRandomVariable> place = CreateObject<UniformRandomVariable> ();
+  place->SetStream (1);
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  Ptr<ConstantPositionMobilityModel> sta = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> ap = CreateObject<ConstantPositionMobilityModel> ();
+
+  uint32_t capacity = SlotsPerCycle (settings);
+  std::vector<uint32_t> load (settings.nAps, 0);
+  std::vector<StationPlan> plan (nWifi);
+  for (uint32_t i = 0; i < nWifi; i++)
+    {
+      plan[i].x = place->GetValue (0, settings.gridWidth * settings.apSpacing);
+      plan[i].y = place->GetValue (0, rows * settings.apSpacing);
+      sta->SetPosition (Vector (plan[i].x, plan[i].y, 0));
+      double best = 0;
+      for (uint32_t c = 0; c < settings.nAps; c++)
+        {
+          ap->SetPosition (ApPosition (c, settings));
+          double score = loss->CalcRxPower (0, sta, ap) - settings.loadPenaltyDb * (load[c] / capacity);
+          if (c == 0 || score > best)
+            {
+              best = score;
+              plan[i].cell = c;
+            }
+        }
+      plan[i].id = ++load[plan[i].cell];
+    }
+  return plan;
+}
+
+struct SlotReuse
+{
+  uint32_t decodable;    // STAs above phyMode's sensitivity at their own AP
+  uint32_t slots;        // colors, summed over the channels
+  uint32_t busiest;      // colors of the channel that needs the most
+};
+
+// Replaces the per-cell IDs by a coloring per channel. The coloring takes
+// every STA of the channel's cells at every AP on it, each STA served by
+// its own cell's AP, and only lets a slot grow while the summed
+// interference, the co-slot APs' ACKs included, leaves every member the
+// SINR phyMode needs. The plan's loss model and the default PHY's tx power
+// and noise figure predict the powers. The APs hand out IDs in idtdma,
+// here the plan does it for them.
+static SlotReuse
+ColorSlots (std::vector<StationPlan> &plan, const MultiApSettings &settings)
+{
+  Ptr<YansWifiPhy> defaults = CreateObject<YansWifiPhy> ();
+  DoubleValue txPower, noiseFigure;
+  defaults->GetAttribute ("TxPowerStart", txPower);
+  defaults->GetAttribute ("RxNoiseFigure", noiseFigure);
+  SlotSinrModel model;
+  model.noiseDbm = -174 + 10 * std::log10 (20e6) + noiseFigure.Get ();
+  model.sensitivityDbm = settings.phyMode.sensitivityDbm;
+  model.dataSinrDb = settings.phyMode.sensitivityDbm - WIFI_SENSITIVITY_NOISE_DBM;
+  model.ackSinrDb = settings.phyMode.ackSensitivityDbm - WIFI_SENSITIVITY_NOISE_DBM;
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  Ptr<ConstantPositionMobilityModel> sta = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> ap = CreateObject<ConstantPositionMobilityModel> ();
+
+  SlotReuse reuse = {0, 0, 0};
+  for (uint32_t ch = 0; ch < settings.nChannels; ch++)
+    {
+      std::vector<uint32_t> receivers, receiverOf (settings.nAps), stations;
+      for (uint32_t c = 0; c < settings.nAps; c++)
+        {
+          if (CellChannel (c, settings) == ch)
+            {
+              receiverOf[c] = receivers.size ();
+              receivers.push_back (c);
+            }
+        }
+      for (uint32_t i = 0; i < plan.size (); i++)
+        {
+          if (CellChannel (plan[i].cell, settings) == ch)
+            {
+              stations.push_back (i);
+            }
+        }
+      if (stations.empty ())
+        {
+          continue;
+        }
+
+      std::vector< std::vector<double> > rxDbm (stations.size (), std::vector<double> (receivers.size ()));
+      std::vector< std::vector<double> > apRxDbm (receivers.size (), std::vector<double> (receivers.size ()));
+      for (uint32_t q = 0; q < receivers.size (); q++)
+        {
+          sta->SetPosition (ApPosition (receivers[q], settings));
+          for (uint32_t r = 0; r < receivers.size (); r++)
+            {
+              ap->SetPosition (ApPosition (receivers[r], settings));
+              apRxDbm[q][r] = loss->CalcRxPower (txPower.Get (), sta, ap);
+            }
+        }
+      std::vector<uint32_t> serving (stations.size ());
+      for (uint32_t s = 0; s < stations.size (); s++)
+        {
+          const StationPlan &p = plan[stations[s]];
+          sta->SetPosition (Vector (p.x, p.y, 0));
+          for (uint32_t r = 0; r < receivers.size (); r++)
+            {
+              ap->SetPosition (ApPosition (receivers[r], settings));
+              rxDbm[s][r] = loss->CalcRxPower (txPower.Get (), sta, ap);
+            }
+          serving[s] = receiverOf[p.cell];
+        }
+      uint32_t nColors;
+      std::vector<uint32_t> color = ColorSlotsBySinr (rxDbm, apRxDbm, serving, model, nColors);
+      for (uint32_t s = 0; s < stations.size (); s++)
+        {
+          plan[stations[s]].id = color[s] + 1;
+        }
+      reuse.decodable += CountDecodable (rxDbm, serving, model.sensitivityDbm);
+      reuse.slots += nColors;
+      reuse.busiest = std::max (reuse.busiest, nColors);
+    }
+  return reuse;
+}
+
+// Builds and runs the cells whose channel is in channels (all of them when
+// empty) and returns one result per cell built.
+static std::vector<CellResult>
+RunDeployment (uint32_t nWifi, const MultiApSettings &settings, const std::set<uint32_t> &channels, ResourceMeter &meter)
+{
+  std::vector<StationPlan> plan = PlanDeployment (nWifi, settings);
+  if (settings.slotReuse)
+    {
+      ColorSlots (plan, settings);
+    }
+  std::vector< std::vector<uint32_t> > members (settings.nAps);
+  for (uint32_t i = 0; i < nWifi; i++)
+    {
+      members[plan[i].cell].push_back (i);
+    }
+
+  std::map<uint32_t, Ptr<YansWifiChannel> > media;
+  std::vector<LatencyProbe> probes (settings.nAps);
+  std::vector<ApplicationContainer> sinks (settings.nAps);
+  std::vector<uint32_t> built;
+
+  WifiHelper wifi;
+  ApplyWifiPhyMode (wifi, settings.phyMode, settings.rateManager);
+  InternetStackHelper stack;
+
+  for (uint32_t c = 0; c < settings.nAps; c++)
+    {
+      uint32_t ch = CellChannel (c, settings);
+      if (!channels.empty () && channels.find (ch) == channels.end ())
+        {
+          continue;
+        }
+      built.push_back (c);
+      if (media.find (ch) == media.end ())
+        {
+          YansWifiChannelHelper channelHelper = YansWifiChannelHelper::Default ();
+          media[ch] = channelHelper.Create ();
+          if (settings.pathLossCache)
+            {
+              EnablePathLossCache (media[ch]);
+            }
+        }
+      YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+      phy.SetChannel (media[ch]);
+      phy.Set ("ChannelNumber", UintegerValue (ch));
+
+      NodeContainer apNode;
+      apNode.Create (1);
+      NodeContainer staNodes;
+      staNodes.Create (members[c].size ());
+
+      std::ostringstream name;
+      name << "cell-" << c;
+      Ssid ssid = Ssid (name.str ());
+      WifiMacHelper mac;
+      mac.SetType ("ns3::StaWifiMac","Ssid", SsidValue (ssid),"ActiveProbing", BooleanValue (false));
+      NetDeviceContainer staDevices = wifi.Install (phy, mac, staNodes);
+      mac.SetType ("ns3::ApWifiMac","Ssid", SsidValue (ssid),"BeaconGeneration", BooleanValue(false),"BeaconInterval", TimeValue(Days(1)));
+      NetDeviceContainer apDevices = wifi.Install (phy, mac, apNode);
+
+      Ptr<ConstantPositionMobilityModel> apPos = CreateObject<ConstantPositionMobilityModel> ();
+      apPos->SetPosition (ApPosition (c, settings));
+      apNode.Get (0)->AggregateObject (apPos);
+      for (uint32_t k = 0; k < members[c].size (); k++)
+        {
+          const StationPlan &p = plan[members[c][k]];
+          Ptr<ConstantPositionMobilityModel> staPos = CreateObject<ConstantPositionMobilityModel> ();
+          staPos->SetPosition (Vector (p.x, p.y, 0));
+          staNodes.Get (k)->AggregateObject (staPos);
+        }
+
+      stack.Install (apNode);
+      stack.Install (staNodes);
+      // one /20 per cell: 10.<c/16>.<(c%16)*16>.0
+      std::ostringstream base;
+      base << "10." << c / 16 << "." << (c % 16) * 16 << ".0";
+      Ipv4AddressHelper address;
+      address.SetBase (base.str ().c_str (), "255.255.240.0");
+      Ipv4InterfaceContainer apInterface = address.Assign (apDevices);
+      address.Assign (staDevices);
+
+      PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (apInterface.GetAddress (0), 9998));
+      sinks[c] = packetSinkHelper.Install (apNode.Get (0));
+      sinks[c].Start (Seconds (0));
+      sinks[c].Stop (Seconds (settings.stopTime));
+      probes[c].Attach (sinks[c].Get (0));
+
+      Ptr<WifiPhy> apPhy = StaticCast<WifiNetDevice> (apDevices.Get (0))->GetPhy ();
+      probes[c].AttachDrops (apPhy);
+
+      for (uint32_t k = 0; k < members[c].size (); k++)
+        {
+          Ptr<staApp> app1 = CreateObject<staApp> (staNodes.Get (k), apInterface.GetAddress (0), plan[members[c][k]].id,
+                                                   settings.packetSize, settings.nPackets, &probes[c]);
+          app1->SetCycle (settings.Tcycle);
+          app1->SetSlotTime (settings.tslot);
+          staNodes.Get (k)->AddApplication (app1);
+          app1->SetStartTime (MilliSeconds (1000));
+          app1->SetStopTime (Seconds (settings.stopTime - 1));
+        }
+    }
+
+  ConfigureWifiPhyMode (settings.phyMode);
+
+  // every STA talks to its AP on-link, the interface routes are enough;
+  // global routing would cost O(nodes^2) at this size
+
+  Simulator::Stop (Seconds (settings.stopTime));
+  meter.SetupDone ();
+  Simulator::Run ();
+
+  uint32_t capacity = SlotsPerCycle (settings);
+  std::vector<CellResult> results;
+  for (uint32_t i = 0; i < built.size (); i++)
+    {
+      uint32_t c = built[i];
+      CellResult r;
+      r.cell = c;
+      r.channel = CellChannel (c, settings);
+      r.stations = members[c].size ();
+      r.overflow = 0;
+      for (uint32_t k = 0; k < members[c].size (); k++)
+        {
+          r.overflow += plan[members[c][k]].id > capacity;
+        }
+      r.sent = probes[c].GetSent ();
+      r.delivered = probes[c].GetDelivered ();
+      r.drops = probes[c].GetDropped ();
+      r.rxBytes = DynamicCast<PacketSink> (sinks[c].Get (0))->GetTotalRx ();
+      r.latencyP50Ms = probes[c].GetPercentileMs (0.5);
+      r.latencyP99Ms = probes[c].GetPercentileMs (0.99);
+      results.push_back (r);
+    }
+  Simulator::Destroy ();
+  return results;
+}
+
+static void
+WriteCellHeader (std::ostream &os)
+{
+  os << "# cell channel stations overflow sent delivered drops rx_bytes p50_ms p99_ms" << std::endl;
+}
+
+static void
+WriteCell (std::ostream &os, const CellResult &r)
+{
+  os << r.cell << " " << r.channel << " " << r.stations << " " << r.overflow
+     << " " << r.sent << " " << r.delivered << " " << r.drops << " " << r.rxBytes
+     << std::fixed << std::setprecision (3) << " " << r.latencyP50Ms << " " << r.latencyP99Ms
+     << std::endl;
+}
+
+static bool
+ReadCells (const std::string &path, std::vector<CellResult> &cells)
+{
+  std::ifstream ifs (path.c_str ());
+  if (!ifs)
+    {
+      return false;
+    }
+  std::string line;
+  while (std::getline (ifs, line))
+    {
+      if (line.empty () || line[0] == '#')
+        {
+          continue;
+        }
+      std::istringstream is (line);
+      CellResult r;
+      is >> r.cell >> r.channel >> r.stations >> r.overflow >> r.sent >> r.delivered
+         >> r.drops >> r.rxBytes >> r.latencyP50Ms >> r.latencyP99Ms;
+      if (!is)
+        {
+          return false;
+        }
+      cells.push_back (r);
+    }
+  return true;
+}
+
+static bool
+CellBefore (const CellResult &a, const CellResult &b)
+{
+  return a.cell < b.cell;
+}
+
+// Runs one copy of this program per channel group and collects their cells
+static bool
+RunPartitioned (int argc, char *argv[], uint32_t jobs, uint32_t nChannels, const std::string &outFile,
+                std::vector<CellResult> &cells)
+{
+  jobs = std::min (jobs, nChannels);
+  std::vector<pid_t> workers;
+  std::vector<std::string> parts;
+  for (uint32_t j = 0; j < jobs; j++)
+    {
+      std::ostringstream channels, part;
+      for (uint32_t ch = j; ch < nChannels; ch += jobs)
+        {
+          channels << (ch == j ? "" : ",") << ch;
+        }
+      part << outFile << ".part" << j;
+      parts.push_back (part.str ());
+
+      // later options win, so the worker sees the parent's settings with
+      // its own channels and output
+      std::vector<std::string> args (argv, argv + argc);
+      args.push_back ("--jobs=1");
+      args.push_back ("--channels=" + channels.str ());
+      args.push_back ("--outFile=" + part.str ());
+      std::vector<char *> cargs;
+      for (uint32_t a = 0; a < args.size (); a++)
+        {
+          cargs.push_back (const_cast<char *> (args[a].c_str ()));
+        }
+      cargs.push_back (0);
+
+      pid_t pid = fork ();
+      if (pid == 0)
+        {
+          execv ("/proc/self/exe", &cargs[0]);
+          _exit (127);
+        }
+      if (pid < 0)
+        {
+          std::cerr << "fork failed: " << std::strerror (errno) << std::endl;
+          return false;
+        }
+      workers.push_back (pid);
+    }
+
+  bool ok = true;
+  for (uint32_t j = 0; j < workers.size (); j++)
+    {
+      int status;
+      if (waitpid (workers[j], &status, 0) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+          std::cerr << "worker " << j << " failed" << std::endl;
+          ok = false;
+        }
+    }
+  for (uint32_t j = 0; ok && j < parts.size (); j++)
+    {
+      ok = ReadCells (parts[j], cells);
+      std::remove (parts[j].c_str ());
+    }
+  std::sort (cells.begin (), cells.end (), CellBefore);
+  return ok;
+}
+
+static void
+PrintSummary (const std::vector<CellResult> &cells)
+{
+  uint64_t stations = 0, overflow = 0, sent = 0, delivered = 0, drops = 0;
+  double worstP99 = 0;
+  for (uint32_t i = 0; i < cells.size (); i++)
+    {
+      stations += cells[i].stations;
+      overflow += cells[i].overflow;
+      sent += cells[i].sent;
+      delivered += cells[i].delivered;
+      drops += cells[i].drops;
+      worstP99 = std::max (worstP99, cells[i].latencyP99Ms);
+    }
+  std::cout<< cells.size ()<<" cells, "<<stations<<" stations ("<<overflow<<" past the cycle's slots): "
+           <<delivered<<"/"<<sent<<" delivered, "<<drops<<" data packets lost at the APs, worst cell p99 "
+           <<worstP99<<" ms"<<std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t nWifi = 2000;
+    uint32_t seed = 1;
+    std::string outFile = "multiap-cells.txt";
+    uint32_t jobs = 1;
+    std::string channelList;
+    std::string phyMode = "11a:0";
+
+    MultiApSettings settings;
+    settings.nAps = 16;
+    settings.gridWidth = 4;
+    settings.apSpacing = 100;
+    settings.nChannels = 4;
+    settings.Tcycle = 10;
+    settings.tslot = 10;
+    settings.packetSize = 200;
+    settings.nPackets = 2;
+    settings.loadPenaltyDb = 3;
+    settings.rateManager = "ns3::ConstantRateWifiManager";
+    settings.pathLossCache = false;
+    settings.stopTime = 201;
+    settings.slotReuse = false;
+
+    CommandLine cmd;
+    cmd.AddValue ("nWifi", "STAs over the whole deployment", nWifi);
+    cmd.AddValue ("nAps", "Number of APs (cells)", settings.nAps);
+    cmd.AddValue ("gridWidth", "APs per grid row", settings.gridWidth);
+    cmd.AddValue ("apSpacing", "Distance between neighbouring APs in m", settings.apSpacing);
+    cmd.AddValue ("nChannels", "Data channels the cells reuse", settings.nChannels);
+    cmd.AddValue ("Tcycle", "Cycle length in seconds", settings.Tcycle);
+    cmd.AddValue ("tslot", "Slot length in ms", settings.tslot);
+    cmd.AddValue ("packetSize", "STA data packet size in bytes", settings.packetSize);
+    cmd.AddValue ("nPackets", "Data packets per STA, one per Tcycle", settings.nPackets);
+    cmd.AddValue ("loadPenaltyDb", "AP choice: dB off a cell's signal per cycle's worth of STAs it has", settings.loadPenaltyDb);
+    cmd.AddValue ("rateManager", "Remote station manager of all devices", settings.rateManager);
+    cmd.AddValue ("phyMode", "Standard and MCS of all devices: 11a:0-7, 11n:0-7, 11ac:0-8 or 11ax:0-11", phyMode);
+    cmd.AddValue ("pathLossCache", "Compute each rx power once (all nodes are static)", settings.pathLossCache);
+    cmd.AddValue ("stopTime", "Simulated seconds", settings.stopTime);
+    cmd.AddValue ("slotReuse", "Color the STAs of each channel into shared slots instead of numbering them per cell", settings.slotReuse);
+    cmd.AddValue ("seed", "RNG seed", seed);
+    cmd.AddValue ("outFile", "Per-cell results", outFile);
+    cmd.AddValue ("jobs", "Processes to split the channels over, 1 runs everything here", jobs);
+    cmd.AddValue ("channels", "Only simulate the cells on these channels (comma separated)", channelList);
+    cmd.Parse (argc,argv);
+
+    NS_ABORT_MSG_IF (settings.nAps == 0 || settings.gridWidth == 0 || settings.nChannels == 0, "Need at least one AP, column and channel");
+    NS_ABORT_MSG_IF (settings.nAps > 4096, "Cell subnets run out past 4096 APs");
+    NS_ABORT_MSG_IF (!ParseWifiPhyMode (phyMode, settings.phyMode), "Unknown phyMode " << phyMode);
+    RngSeedManager::SetSeed (seed);
+
+    std::set<uint32_t> channels;
+    std::istringstream list (channelList);
+    std::string item;
+    while (std::getline (list, item, ','))
+      {
+        channels.insert (boost::lexical_cast<uint32_t> (item));
+      }
+
+    ResourceMeter meter;
+    meter.Start ();
+    std::vector<CellResult> cells;
+    if (jobs > 1 && channels.empty ())
+      {
+        if (!RunPartitioned (argc, argv, jobs, settings.nChannels, outFile, cells))
+          {
+            NS_FATAL_ERROR ("Partitioned run failed");
+          }
+      }
+    else
+      {
+        cells = RunDeployment (nWifi, settings, channels, meter);
+      }
+    RunResources cost = meter.Stop (0);
+
+    std::ofstream ofs (outFile.c_str ());
+    WriteCellHeader (ofs);
+    WriteCellHeader (std::cout);
+    for (uint32_t i = 0; i < cells.size (); i++)
+      {
+        WriteCell (ofs, cells[i]);
+        WriteCell (std::cout, cells[i]);
+      }
+    PrintSummary (cells);
+    if (settings.slotReuse)
+      {
+        // the plan is deterministic, so redo it here rather than ship the
+        // numbers back from the workers
+        std::vector<StationPlan> plan = PlanDeployment (nWifi, settings);
+        uint32_t perCell = 0;
+        for (uint32_t i = 0; i < plan.size (); i++)
+          {
+            perCell = std::max (perCell, plan[i].id);
+          }
+        SlotReuse reuse = ColorSlots (plan, settings);
+        // over decodable STAs only: the rest gain nothing from a slot
+        std::cout<< "slot reuse: "<<reuse.decodable<<" decodable stations in "<<reuse.slots<<" slots over "
+                 <<settings.nChannels<<" channels, reuse factor "<<double (reuse.decodable) / std::max (1u, reuse.slots)
+                 <<"; busiest channel "<<reuse.busiest<<" slots, largest cell "<<perCell<<" IDs"<<std::endl;
+      }
+    if (jobs > 1 && channels.empty ())
+      {
+        // the workers' setup, CPU and memory are their own; only wall time is ours
+        std::cout<< std::min (jobs, settings.nChannels) <<" processes, wall "<<cost.runWallS<<" s"<<std::endl;
+      }
+    else
+      {
+        std::cout<< "setup "<<cost.setupWallS<<" s, run "<<cost.runWallS<<" s, peak rss "<<cost.peakRssKb<<" kB"<<std::endl;
+      }
+    return 0;
+}
@@ -24,15 +24,30 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 
+#include "cached-propagation-loss-model.h"
+#include "event-profiler.h"
+#include "idtdma-trace.h"
+#include "latency-probe.h"
+#include "run-resources.h"
+#include "simulation-heartbeat.h"
+#include "sweep-cache.h"
+#include "sweep-results.h"
+#include "wifi-phy-mode.h"
+
 #include <string>
 #include <list>
 #include <boost/lexical_cast.hpp>
 #include <cmath>
+#include <map>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("device1");
 
+// binary station lifecycle trace, see idtdma-trace-decode
+IdtdmaTraceBuffer g_trace;
+LatencyProbe g_latency;
+
 class apApp : public Application
 {
 public:
@@ -170,7 +185,7 @@ staApp::staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1,uint32_t id,
 void
 staApp::StartApplication (void)
 {
-//  std::cout<<"START "<<m_id<<" "<<Simulator::Now()<<std::endl;
+  g_trace.Record (IDTDMA_TRACE_START, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id);
   //RequestId ();
     ScheduleAssociation (0);
 //    ScheduleRequestId ();
@@ -191,7 +206,7 @@ staApp::StopApplication (void)
 
 void staApp::StartAssociation (int device)
 {
-//  std::cout<<"SCHED "<<m_id<<" "<<Simulator::Now()<<std::endl;
+  g_trace.Record (IDTDMA_TRACE_SCHED, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id, device);
     m_macs[device]->SetAttribute ("ActiveProbing",BooleanValue(true));
 //    if (device ==1)
 //      {
@@ -207,11 +222,11 @@ void staApp::ScheduleAssociation (int device)
 //    tNext+=MilliSeconds(m_id*m_tslot);
 //    Simulator::Schedule (tNext - tNow, &staApp::StartAssociation, this, device);
 //    Time tNext (MilliSeconds(2));
-    m_sendEvent = Simulator::Schedule (MilliSeconds(m_id*m_tslot), &staApp::StartAssociation, this,device);
+    m_sendEvent = ScheduleNamed ("staApp::StartAssociation", MilliSeconds(m_id*m_tslot), &staApp::StartAssociation, this,device);
     if (device ==1)
       {
         Time tNext (Seconds(m_Tcycle));
-        m_sendEvent = Simulator::Schedule (tNext, &staApp::StartAssociation, this,device);
+        m_sendEvent = ScheduleNamed ("staApp::StartAssociation", tNext, &staApp::StartAssociation, this,device);
       }
 }
 
@@ -222,13 +237,12 @@ void staApp::ScheduleRequestId()
 //    Time tNext(Seconds(tSec+1)); // start on the next second
 //    tNext+=MilliSeconds(m_id*m_tslot);
 //    Simulator::Schedule (tNext - tNow, &staApp::RequestId, this);
-      Simulator::Schedule (Seconds(m_Tcycle), &staApp::RequestId, this);
+      ScheduleNamed ("staApp::RequestId", Seconds(m_Tcycle), &staApp::RequestId, this);
 }
 
 void staApp::RequestId ()
 {
-//  std::cout<<"REQU ID "<<m_id<<" "<<Simulator::Now()<<std::endl;
-
+  g_trace.Record (IDTDMA_TRACE_REQU_ID, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id);
     Ptr<Packet> packet = Create<Packet> (64);
     uint16_t apPort = 9996;
     Address apAddress (InetSocketAddress (m_peer, apPort));
@@ -237,12 +251,12 @@ void staApp::RequestId ()
 
 void staApp::UpdateId(Ptr<Socket> socket)
 {
-//  std::cout<<"UPD ID "<<m_id<<" "<<Simulator::Now()<<std::endl;
-
   Ptr<Packet> packet=socket->Recv ();
   std::ostringstream ostr;
   packet->CopyData(&ostr, packet->GetSize());
+  uint32_t oldId = m_id;
   m_id=boost::lexical_cast<uint32_t>(ostr.str ());
+  g_trace.Record (IDTDMA_TRACE_UPD_ID, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), oldId, m_id);
 
 
 
@@ -256,7 +270,7 @@ void staApp::ScheduleTx (void)
 //    double tSec=std::round(tNow.GetSeconds ());
 //    Time tNext(Seconds(tSec+1)); // start on the next second
 //    tNext+=MilliSeconds(m_nWifi*m_tslot );
-    m_sendEvent = Simulator::Schedule (Seconds(m_Tcycle), &staApp::SendPacket,this);
+    m_sendEvent = ScheduleNamed ("staApp::SendPacket", Seconds(m_Tcycle), &staApp::SendPacket,this);
 //    Time tNext (MilliSeconds(0));
 //    if (m_packetsSent==0)
 //        {
@@ -276,6 +290,7 @@ void staApp::SendPacket (void)
     Ptr<Packet> packet = Create<Packet> (m_packetSize);
     uint16_t apPort = 9998;
     Address apAddress (InetSocketAddress (m_peer1, apPort));
+    g_latency.Stamp (packet);
     m_sockets[1]->SendTo(packet,0,apAddress);
     if (++m_packetsSent<m_nPackets)
     {
@@ -300,6 +315,36 @@ static void ApPhyRxDrop(Ptr<const Packet> p)
   nDropConn++;
 }
 
+// One results record from what the cell measured or the cache returned
+static void
+AddSweepRecord (SweepResultsWriter &writer, uint32_t nWifi, uint32_t Tcycle, uint32_t seed,
+                uint32_t packetSize, const WifiPhyMode &mode, bool fixedRate, std::map<std::string, double> &results)
+{
+  SweepRecord r;
+  SweepRecordInit (r, "idtdma-tests2");
+  r.nWifi = nWifi;
+  r.Tcycle = Tcycle;
+  r.seed = seed;
+  r.packetSize = packetSize;
+  r.sent = results["sent"];
+  r.delivered = results["delivered"];
+  r.rxBytes = results["rx_bytes"];
+  r.drops = results["drops"];
+  r.deliveryRatio = r.sent > 0 ? (double)r.delivered / r.sent : 0;
+  r.dropRate = r.sent > 0 ? (double)r.drops / r.sent : 0;
+  r.latencyP50Ms = results["latency_p50_ms"];
+  r.latencyP90Ms = results["latency_p90_ms"];
+  r.latencyP99Ms = results["latency_p99_ms"];
+  r.latencyMaxMs = results["latency_max_ms"];
+  r.wallS = results["wall_s"];
+  std::strncpy (r.phyMode, mode.name.c_str (), sizeof (r.phyMode) - 1);
+  // a rate manager that adapts sends at rates of its own, not the mode's MCS
+  if (fixedRate)
+    {
+      r.slotCeiling = Tcycle / (SlotAirtimeSeconds (mode.slot, packetSize) + SlotGuardSeconds (mode.slot));
+    }
+  writer.Add (r);
+}
 
 int main (int argc, char *argv[])
 {
@@ -311,12 +356,56 @@ int main (int argc, char *argv[])
 
   uint32_t Tcycle[] = {1,5,10,30,60};
 
-//    CommandLine cmd;
-//    cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
-//    cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
-//    cmd.AddValue ("tracing", "Enable pcap tracing", tracing);
+    bool staticNodes = false;
+    std::string traceFile;
+    std::string heartbeatFile;
+    bool heartbeatStderr = false;
+    double heartbeatInterval = 10;
+    bool profile = false;
+    std::string profileFile;
+    uint32_t seed = 1;
+    std::string resourceFile = "packet-drop-resources.csv";
+    uint32_t packetSize = 200;
+    std::string rateManager = "ns3::ConstantRateWifiManager";
+    std::string cacheDir = ".sweep-cache";
+    bool invalidateCache = false;
+    std::string resultsFile = "sweep-results.bin";
+    std::string phyModes = "11a:0";
+
+    CommandLine cmd;
+    cmd.AddValue ("staticNodes", "Fixed install: constant STA positions and cached path loss", staticNodes);
+    cmd.AddValue ("traceFile", "Binary lifecycle trace of the whole sweep, empty to disable", traceFile);
+    cmd.AddValue ("heartbeatFile", "Status file rewritten with progress every heartbeatInterval", heartbeatFile);
+    cmd.AddValue ("heartbeatStderr", "Also print the heartbeat to stderr", heartbeatStderr);
+    cmd.AddValue ("heartbeatInterval", "Wall-clock seconds between heartbeats", heartbeatInterval);
+    cmd.AddValue ("profile", "Report wall time per event type of every cell", profile);
+    cmd.AddValue ("profileFile", "Append the profile reports here instead of stderr", profileFile);
+    cmd.AddValue ("seed", "RNG seed of the sweep, recorded with every cell", seed);
+    cmd.AddValue ("resourceFile", "CPU, memory and event count per cell, empty to disable", resourceFile);
+    cmd.AddValue ("packetSize", "STA data packet size in bytes", packetSize);
+    cmd.AddValue ("rateManager", "Remote station manager of all devices", rateManager);
+    cmd.AddValue ("cacheDir", "Directory of cached cell results, empty to disable", cacheDir);
+    cmd.AddValue ("invalidateCache", "Simulate every cell again and overwrite its cached results", invalidateCache);
+    cmd.AddValue ("resultsFile", "Columnar results of every cell, appended to; empty to disable", resultsFile);
+    cmd.AddValue ("phyModes", "Comma separated standard:mcs list to sweep, e.g. 11a:0,11n:7,11ac:8,11ax:11", phyModes);
+    cmd.Parse (argc,argv);
+
+    std::vector<WifiPhyMode> modes;
+    std::istringstream modeList (phyModes);
+    std::string spec;
+    while (std::getline (modeList, spec, ','))
+      {
+        WifiPhyMode mode;
+        NS_ABORT_MSG_IF (!ParseWifiPhyMode (spec, mode), "Unknown phy mode " << spec);
+        modes.push_back (mode);
+      }
+
+    RngSeedManager::SetSeed (seed);
 
-//    cmd.Parse (argc,argv);
+    if (!traceFile.empty () && !g_trace.Open (traceFile))
+      {
+        NS_FATAL_ERROR ("Cannot open trace file " << traceFile);
+      }
 
     Packet::EnablePrinting ();
 
@@ -327,12 +416,65 @@ int main (int argc, char *argv[])
     std::ofstream ofs;
     ofs.open("packet-drop-percent.txt");
 
+    std::ofstream resources;
+    if (!resourceFile.empty ())
+      {
+        resources.open (resourceFile.c_str ());
+        ResourceMeter::WriteCsvHeader (resources);
+      }
+    ResourceMeter meter;
+
+    SweepResultsWriter sweepResults;
+    if (!resultsFile.empty () && !sweepResults.Open (resultsFile))
+      {
+        NS_FATAL_ERROR ("Cannot append to results file " << resultsFile);
+      }
+
+    // a cell that writes a trace or a profile has to run even when cached
+    SweepCache cache;
+    cache.Open (cacheDir, invalidateCache || !traceFile.empty () || profile);
+
+for (uint32_t m=0; m<modes.size (); m++)
+{
+    std::string modeRateManager = rateManager.empty () ? DefaultRateManager (modes[m]) : rateManager;
+    bool fixedRate = modeRateManager == "ns3::ConstantRateWifiManager";
 for (int i=0; i<20; i++)
 {
+        // one row per mode and nWifi, one value per Tcycle
+        ofs<<modes[m].name<<" ";
         for (int j=0; j<5; j++)
             {
                 nDropConn =0;
 
+                std::ostringstream config;
+                config << "scenario idtdma-tests2\n"
+                       << "nWifi " << nWifi[i] << "\n"
+                       << "Tcycle " << Tcycle[j] << "\n"
+                       << "packetSize " << packetSize << "\n"
+                       << "rateManager " << modeRateManager << "\n"
+                       << "staticNodes " << staticNodes << "\n"
+                       << "seed " << seed << "\n";
+                // the default mode keeps the keys of cells cached before it existed
+                if (modes[m].name != "11a:0")
+                  {
+                    config << "phyMode " << modes[m].name << "\n";
+                  }
+                std::map<std::string, double> results;
+                if (cache.Lookup (config.str (), results))
+                  {
+                    std::cout<< "For nWifi="<<nWifi[i]<< " Tc="<<Tcycle[j]<<" "<<modes[m].name<<" (cached)"<<std::endl;
+                    std::cout<<(uint64_t)results["rx_bytes"]<< " Total Rx Bytes"<<std::endl;
+                    std::cout<<(uint64_t)results["phy_drops"]<<" Dropped packets at Phy"<<std::endl;
+                    ofs<<(results["phy_drops"]/(2*nWifi[i]))*100.0<<" ";
+                    AddSweepRecord (sweepResults, nWifi[i], Tcycle[j], seed, packetSize, modes[m], fixedRate, results);
+                    continue;
+                  }
+
+                SeedSweepCell (config.str ());
+                meter.Start ();
+                g_latency.Reset ();
+                g_trace.Record (IDTDMA_TRACE_CELL, 0, 0, nWifi[i], Tcycle[j]);
+
                 // Nodes and containers
                 NodeContainer wifiStaNodes;
                 wifiStaNodes.Create (nWifi[i]);
@@ -346,18 +488,25 @@ for (int i=0; i<20; i++)
                 // Assoc Channel
                 YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
                 YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
-                phy.SetChannel (channel.Create ());
+                Ptr<YansWifiChannel> assocChannel = channel.Create ();
+                phy.SetChannel (assocChannel);
                 phy.Set("ChannelNumber",UintegerValue(0));
 
                 // Connection Chann1
                 YansWifiChannelHelper channel1 = YansWifiChannelHelper::Default ();
                 YansWifiPhyHelper phy1 = YansWifiPhyHelper::Default ();
-                phy1.SetChannel (channel1.Create ());
+                Ptr<YansWifiChannel> dataChannel = channel1.Create ();
+                phy1.SetChannel (dataChannel);
                 phy1.Set("ChannelNumber",UintegerValue(1));
 
+                if (staticNodes)
+                  {
+                    EnablePathLossCache (assocChannel);
+                    EnablePathLossCache (dataChannel);
+                  }
+
                 WifiHelper wifi;
-                //wifi.SetStandard(WIFI_PHY_STANDARD_80211n_5GHZ);
-                wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager");
+                ApplyWifiPhyMode (wifi, modes[m], modeRateManager);
 
                 WifiMacHelper mac;
                 Ssid ssid = Ssid ("ns-3-ssid");
@@ -375,6 +524,7 @@ for (int i=0; i<20; i++)
                 NetDeviceContainer apDevices, apDevices1;
                 apDevices = wifi.Install (phy, mac, wifiApNode);
                 apDevices1 = wifi.Install(phy1,mac,wifiApNode);
+                ConfigureWifiPhyMode (modes[m]);
 
 
                 // mobility configuration
@@ -387,8 +537,15 @@ for (int i=0; i<20; i++)
                                                "GridWidth", UintegerValue (20),
                                                "LayoutType", StringValue ("RowFirst"));
 
-                mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                                           "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+                if (staticNodes)
+                  {
+                    mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+                  }
+                else
+                  {
+                    mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                                               "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+                  }
                 mobility.Install (wifiStaNodes);
 
                 mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
@@ -403,6 +560,18 @@ for (int i=0; i<20; i++)
                 stack.Install (wifiApNode);
                 stack.Install (wifiStaNodes);
 
+                // explicit streams: automatic ones depend on the cells built before
+                int64_t stream = 0;
+                stream += channel.AssignStreams (assocChannel, stream);
+                stream += channel1.AssignStreams (dataChannel, stream);
+                stream += wifi.AssignStreams (staDevices0, stream);
+                stream += wifi.AssignStreams (staDevices1, stream);
+                stream += wifi.AssignStreams (apDevices, stream);
+                stream += wifi.AssignStreams (apDevices1, stream);
+                stream += mobility.AssignStreams (wifiStaNodes, stream);
+                stream += stack.AssignStreams (wifiApNode, stream);
+                stream += stack.AssignStreams (wifiStaNodes, stream);
+
                 Ipv4AddressHelper address;
                 Ipv4InterfaceContainer wifiInterfaces0;
                 Ipv4InterfaceContainer wifiInterfaces1;
@@ -430,15 +599,17 @@ for (int i=0; i<20; i++)
                 ApplicationContainer sinkApps = packetSinkHelper.Install (wifiApNode.Get (0));
                 sinkApps.Start (Seconds (0));
                 sinkApps.Stop (Seconds (301));
+                g_latency.Attach (sinkApps.Get (0));
                 //
 
                 Ptr<WifiNetDevice> apwifidev = StaticCast<WifiNetDevice>(apDevices1.Get (0));
                 Ptr<WifiPhy> apPhy = apwifidev->GetMac()->GetWifiPhy();
                 apPhy->TraceConnectWithoutContext("PhyRxDrop",MakeCallback(&ApPhyRxDrop));
+                g_latency.AttachDrops (apPhy);
 
                 for (uint32_t k=0; k<nWifi[i]; k++)
                   {
-                    Ptr<staApp> app1 = CreateObject<staApp> (wifiStaNodes.Get (k), apInterface.GetAddress(0), apInterface1.GetAddress(0), k, 200, 2, nWifi[i]);
+                    Ptr<staApp> app1 = CreateObject<staApp> (wifiStaNodes.Get (k), apInterface.GetAddress(0), apInterface1.GetAddress(0), k, packetSize, 2, nWifi[i]);
                     app1->SetCycle(Tcycle[j]);
                     wifiStaNodes.Get (k)->AddApplication (app1);
                     double tslot= (double)Tcycle[j]/(double)nWifi[i];
@@ -452,18 +623,58 @@ for (int i=0; i<20; i++)
 
                 Simulator::Stop (Seconds (301.0));
 
+                std::ostringstream label;
+                label << "nWifi=" << nWifi[i] << " Tc=" << Tcycle[j] << " " << modes[m].name;
+                // always installed, it also counts the events for the resource file;
+                // with no status file and no stderr it does nothing else
+                EnableHeartbeat (label.str (), Seconds (301.0), heartbeatFile, heartbeatStderr, heartbeatInterval);
+                if (profile)
+                  {
+                    EnableEventProfiler (label.str (), profileFile);
+                  }
+
+                meter.SetupDone ();
                 Simulator::Run ();
                 Simulator::Destroy ();
+                RunResources cost = meter.Stop (Heartbeat::GetEvents ());
+                if (resources.is_open ())
+                  {
+                    ResourceMeter::WriteCsv (resources, nWifi[i], Tcycle[j], seed, modes[m].name, cost);
+                  }
 
                 uint64_t totalPacketsThrough = DynamicCast<PacketSink> (sinkApps.Get(0))->GetTotalRx ();
-                std::cout<< "For nWifi="<<nWifi[i]<< " Tc="<<Tcycle[j]<<std::endl;
+                std::cout<< "For nWifi="<<nWifi[i]<< " Tc="<<Tcycle[j]<<" "<<modes[m].name<<std::endl;
                 std::cout<<totalPacketsThrough<< " Total Rx Bytes"<<std::endl;
                 std::cout<< nDropConn<<" Dropped packets at Phy"<<std::endl;
                 ofs<<((double)nDropConn/(2*nWifi[i]))*100.0<<" ";
+
+                // every frame the PHY dropped, for the legacy outputs; the
+                // sweep record only counts data packets, each once
+                results["phy_drops"] = nDropConn;
+                results["drops"] = g_latency.GetDropped ();
+                results["rx_bytes"] = totalPacketsThrough;
+                results["sent"] = g_latency.GetSent ();
+                results["delivered"] = g_latency.GetDelivered ();
+                results["latency_p50_ms"] = g_latency.GetPercentileMs (0.5);
+                results["latency_p90_ms"] = g_latency.GetPercentileMs (0.9);
+                results["latency_p99_ms"] = g_latency.GetPercentileMs (0.99);
+                results["latency_max_ms"] = g_latency.GetPercentileMs (1);
+                results["wall_s"] = cost.setupWallS + cost.runWallS;
+                cache.Store (config.str (), results);
+                AddSweepRecord (sweepResults, nWifi[i], Tcycle[j], seed, packetSize, modes[m], fixedRate, results);
           }
         ofs<<std::endl;
+        sweepResults.Flush ();
   }
+}
     ofs.close();
+    resources.close ();
+    sweepResults.Close ();
+    if (cache.IsOpen ())
+      {
+        std::cout<< cache.GetHits ()<<" cells from cache, "<<cache.GetMisses ()<<" simulated"<<std::endl;
+      }
+    g_trace.Close ();
     return 0;
 }
 
@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Decodes the binary lifecycle trace written by idtdma / idtdma-tests.
+//
+//   idtdma-trace-decode idtdma-trace.bin          -> "START 3 +1000000000.0ns" lines
+//   idtdma-trace-decode --csv idtdma-trace.bin    -> time_ns,event,node,arg0,arg1
+
+#include "idtdma-trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int
+Usage (void)
+{
+  std::cerr << "usage: idtdma-trace-decode [--csv] <trace file>" << std::endl;
+  return 2;
+}
+
+int
+main (int argc, char *argv[])
+{
+  bool csv = false;
+  std::string path;
+  for (int i = 1; i < argc; i++)
+    {
+      if (std::strcmp (argv[i], "--csv") == 0)
+        {
+          csv = true;
+        }
+      else if (path.empty ())
+        {
+          path = argv[i];
+        }
+      else
+        {
+          return Usage ();
+        }
+    }
+  if (path.empty ())
+    {
+      return Usage ();
+    }
+
+  FILE *f = std::fopen (path.c_str (), "rb");
+  if (f == 0)
+    {
+      std::cerr << "Cannot open " << path << std::endl;
+      return 1;
+    }
+  IdtdmaTraceFileHeader header;
+  if (std::fread (&header, sizeof (header), 1, f) != 1
+      || std::memcmp (header.magic, "IDTR", 4) != 0
+      || header.version != IDTDMA_TRACE_VERSION
+      || header.recordSize != sizeof (IdtdmaTraceRecord))
+    {
+      std::cerr << path << " is not an idtdma trace" << std::endl;
+      std::fclose (f);
+      return 1;
+    }
+
+  if (csv)
+    {
+      std::printf ("time_ns,event,node,arg0,arg1\n");
+    }
+
+  std::vector<IdtdmaTraceRecord> block (65536);
+  size_t n;
+  while ((n = std::fread (&block[0], sizeof (IdtdmaTraceRecord), block.size (), f)) > 0)
+    {
+      for (size_t i = 0; i < n; i++)
+        {
+          const IdtdmaTraceRecord &r = block[i];
+          if (csv)
+            {
+              std::printf ("%lld,%s,%u,%lld,%lld\n", (long long)r.timeNs, IdtdmaTraceEventName (r.type),
+                           r.node, (long long)r.arg[0], (long long)r.arg[1]);
+            }
+          else if (r.type == IDTDMA_TRACE_CELL)
+            {
+              std::printf ("CELL nWifi=%lld Tc=%lld\n", (long long)r.arg[0], (long long)r.arg[1]);
+            }
+          else
+            {
+              // same layout the scenarios used to print with std::cout
+              std::printf ("%s %lld %+lld.0ns\n", IdtdmaTraceEventName (r.type),
+                           (long long)r.arg[0], (long long)r.timeNs);
+            }
+        }
+    }
+  std::fclose (f);
+  return 0;
+}
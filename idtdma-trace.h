@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef IDTDMA_TRACE_H
+#define IDTDMA_TRACE_H
+
+// Station lifecycle trace of the idtdma scenarios. Fixed 32-byte records are
+// collected in a preallocated block and written out with a single write()
+// whenever the block fills up; idtdma-trace-decode turns the file back into
+// text or CSV. No ns-3 dependency so the decoder builds on its own.
+
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+enum IdtdmaTraceEvent
+{
+  IDTDMA_TRACE_START = 1,   // arg0 = id
+  IDTDMA_TRACE_SCHED,       // arg0 = id, arg1 = device
+  IDTDMA_TRACE_REQU_ID,     // arg0 = id
+  IDTDMA_TRACE_UPD_ID,      // arg0 = old id, arg1 = new id
+  IDTDMA_TRACE_CELL,        // sweep cell starts: arg0 = nWifi, arg1 = Tcycle
+  IDTDMA_TRACE_ID_RETRY,    // ID request resent: arg0 = id, arg1 = attempt
+  IDTDMA_TRACE_ID_GIVEUP,   // no ID after the last retry: arg0 = id, arg1 = attempts
+};
+
+struct IdtdmaTraceRecord
+{
+  int64_t timeNs;
+  uint32_t node;
+  uint16_t type;
+  uint16_t reserved;
+  int64_t arg[2];
+};
+
+struct IdtdmaTraceFileHeader
+{
+  char magic[4];            // "IDTR"
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t reserved;
+};
+
+static const uint32_t IDTDMA_TRACE_VERSION = 1;
+
+inline const char *
+IdtdmaTraceEventName (uint16_t type)
+{
+  switch (type)
+    {
+    case IDTDMA_TRACE_START:
+      return "START";
+    case IDTDMA_TRACE_SCHED:
+      return "SCHED";
+    case IDTDMA_TRACE_REQU_ID:
+      return "REQU ID";
+    case IDTDMA_TRACE_UPD_ID:
+      return "UPD ID";
+    case IDTDMA_TRACE_CELL:
+      return "CELL";
+    case IDTDMA_TRACE_ID_RETRY:
+      return "RETRY ID";
+    case IDTDMA_TRACE_ID_GIVEUP:
+      return "GIVEUP ID";
+    }
+  return "UNKNOWN";
+}
+
+class IdtdmaTraceBuffer
+{
+public:
+  IdtdmaTraceBuffer ();
+  ~IdtdmaTraceBuffer ();
+
+  // records per block; 64k records is a 2 MiB write
+  bool Open (std::string path, uint32_t blockRecords = 65536);
+  void Close (void);
+  bool IsOpen (void) const;
+
+  void Record (uint16_t type, uint32_t node, int64_t timeNs, int64_t arg0 = 0, int64_t arg1 = 0);
+  void Flush (void);
+
+private:
+  void WriteAll (const void *data, size_t size);
+
+  int m_fd;
+  std::vector<IdtdmaTraceRecord> m_block;
+  size_t m_used;
+};
+
+inline
+IdtdmaTraceBuffer::IdtdmaTraceBuffer ()
+  : m_fd (-1),
+    m_used (0)
+{
+}
+
+inline
+IdtdmaTraceBuffer::~IdtdmaTraceBuffer ()
+{
+  Close ();
+}
+
+inline bool
+IdtdmaTraceBuffer::Open (std::string path, uint32_t blockRecords)
+{
+  Close ();
+  m_fd = open (path.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (m_fd < 0)
+    {
+      return false;
+    }
+  m_block.resize (blockRecords);
+  m_used = 0;
+
+  IdtdmaTraceFileHeader header;
+  std::memcpy (header.magic, "IDTR", 4);
+  header.version = IDTDMA_TRACE_VERSION;
+  header.recordSize = sizeof (IdtdmaTraceRecord);
+  header.reserved = 0;
+  WriteAll (&header, sizeof (header));
+  return true;
+}
+
+inline void
+IdtdmaTraceBuffer::Close (void)
+{
+  if (m_fd < 0)
+    {
+      return;
+    }
+  Flush ();
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      m_fd = -1;
+    }
+}
+
+inline bool
+IdtdmaTraceBuffer::IsOpen (void) const
+{
+  return m_fd >= 0;
+}
+
+inline void
+IdtdmaTraceBuffer::Record (uint16_t type, uint32_t node, int64_t timeNs, int64_t arg0, int64_t arg1)
+{
+  if (m_fd < 0)
+    {
+      return;
+    }
+  IdtdmaTraceRecord &r = m_block[m_used];
+  r.timeNs = timeNs;
+  r.node = node;
+  r.type = type;
+  r.reserved = 0;
+  r.arg[0] = arg0;
+  r.arg[1] = arg1;
+  if (++m_used == m_block.size ())
+    {
+      Flush ();
+    }
+}
+
+inline void
+IdtdmaTraceBuffer::Flush (void)
+{
+  if (m_fd < 0 || m_used == 0)
+    {
+      return;
+    }
+  WriteAll (&m_block[0], m_used * sizeof (IdtdmaTraceRecord));
+  m_used = 0;
+}
+
+inline void
+IdtdmaTraceBuffer::WriteAll (const void *data, size_t size)
+{
+  const char *p = static_cast<const char *> (data);
+  while (size > 0)
+    {
+      ssize_t n = write (m_fd, p, size);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          // give up on tracing rather than on the simulation
+          close (m_fd);
+          m_fd = -1;
+          return;
+        }
+      p += n;
+      size -= n;
+    }
+}
+
+#endif /* IDTDMA_TRACE_H */
@@ -24,37 +24,381 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 
+#include "cached-propagation-loss-model.h"
+#include "event-profiler.h"
+#include "idtdma-trace.h"
+#include "pcapng-capture.h"
+#include "simulation-heartbeat.h"
+#include "slot-airtime.h"
+#include "slot-map.h"
+#include "station-clock.h"
+#include "wifi-phy-mode.h"
+
 #include <string>
 #include <list>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 #include <cmath>
+#include <map>
+#include <sstream>
+#include <vector>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("device1");
 
+// binary station lifecycle trace, see idtdma-trace-decode
+IdtdmaTraceBuffer g_trace;
+
+// ID acquisition, reported at the end of the run
+uint32_t nIdAssigned = 0;
+uint32_t nIdRetries = 0;
+uint32_t nIdGiveUps = 0;
+uint32_t nIdRepeated = 0;
+uint32_t nIdFrames = 0;            // ID replies or slot maps the AP sent
+uint32_t nIdFrameBytes = 0;
+std::vector<double> g_joinSeconds; // app start to first ID, per station
+
+// slot maps go to every STA on the association channel
+static const uint16_t SLOT_MAP_PORT = 9997;
+static const uint32_t SLOT_MAP_MAX_BYTES = 1400;
+
+// clock model: each STA's oscillator drifts by up to driftPpm, the AP
+// broadcasts its time on the data channel every syncInterval
+static const uint16_t SYNC_PORT = 9995;
+double g_maxDriftPpm = 0;
+double g_maxSlotError = 0;  // s, |actual - nominal| data slot start
+double g_maxSyncError = 0;  // s, clock error left right after a sync
+uint32_t nSlotSamples = 0;
+uint32_t nSyncBeacons = 0;
+
+// superframe mode: one channel, each cycle opens with a contention window
+// for joins whose length the AP announces one cycle ahead
+static const uint16_t SUPERFRAME_PORT = 9994;
+uint32_t nSuperframes = 0;
+double g_joinWindowSum = 0; // s, over all announcements
+double g_joinWindowMax = 0;
+
+// retransmission pool: retxSlots slots at the end of every cycle for data
+// frames the STA MAC gave up on. In NACK mode one more slot ahead of them
+// carries the AP's list of slots it saw fail, listed IDs retransmit in
+// list order; otherwise stations claim a pool slot by hashing their ID.
+static const uint16_t RETX_PORT = 9993;
+uint32_t nDataFailed = 0;
+uint32_t nRetxSent = 0;
+uint32_t nRetxUnclaimed = 0; // NACK pool full, frame dropped
+uint32_t nRxFirstTry = 0;
+uint32_t nRxAfterRetry = 0;
+uint32_t nNacked = 0;
+
+// churn: stations die and reboot; the AP reclaims IDs whose lease ran out
+// and periodically renumbers the survivors into the lowest slots
+uint32_t nLeaves = 0;
+uint32_t nRejoins = 0;
+uint32_t nReclaimed = 0;
+uint32_t nCompactions = 0;
+uint32_t nIdMoved = 0;         // stations that adopted a compacted ID
+uint32_t nCompactionBytes = 0;
+double g_effCycleSum = 0;      // s, highest assigned ID * tslot per lease check
+uint32_t nEffCycleSamples = 0;
+std::vector<double> g_rejoinToData; // s, rejoin to first data frame
+
+// adaptive cycle: the AP sizes cycle and slot to the assigned IDs and the
+// measured data frame airtime, and announces each change one cycle ahead
+static const uint16_t CYCLE_PORT = 9992;
+uint32_t nCycleAnnouncements = 0;
+uint32_t nCycleChanges = 0;
+double g_cycleSum = 0;   // s, over all cycles the AP ran
+double g_airtime = 0;    // s, smoothed data frame airtime at the AP
+
+// variable slots: stations put their payload size in the ID request and
+// the AP packs slots of exactly that airtime back to back, answering with
+// the slot's offset in the cycle
+uint32_t nVarSlots = 0;
+uint32_t nVarOverflow = 0; // slots that ran past the end of the cycle
+double g_varAirtime = 0;   // s, sum of assigned slot widths
+double g_varMaxSlot = 0;   // s, widest slot assigned
+
+// aggregation: stations sample a reading every readingInterval and send
+// what accumulated since their last slot as one batch, as many readings as
+// fit the slot's payload size; the rest waits for the next slot
+uint32_t g_readingSize = 0;  // bytes per reading, 0 sends one plain datagram
+SlotPhy g_dataPhy;           // data channel timing, for the efficiency report
+uint32_t nReadings = 0;
+uint32_t nReadingsDropped = 0; // station buffer full
+uint32_t nReadingsDelivered = 0;
+uint32_t nBatchFrames = 0;
+double g_batchAirtime = 0;   // s, slot airtime of the delivered batches
+
+// group ACK: data frames go out unacknowledged (subnet broadcast on an
+// ad hoc data channel) and the AP broadcasts a bitmap of the IDs it heard
+// from at every cycle boundary; stations missing from it resend
+//
+//   frame: 'G' 'A' cycle(u32) firstId(u16) nIds(u16) bitmap, MSB first
+static const uint16_t GROUP_ACK_PORT = 9991;
+static const uint32_t GROUP_ACK_MAX_BYTES = 1400;
+uint32_t nGroupAckFrames = 0;
+uint32_t nGroupAckBytes = 0;
+uint32_t nGroupAcked = 0;
+uint32_t nGroupLost = 0;
+
+// alarms: the data grid stops after every k data slots for a group of
+// alarmSlots emergency slots; a station with an alarm sends it in the next
+// group, in the slot its ID hashes to. Groups come often enough that the
+// wait for one, plus its slots, stays within alarmTarget whatever Tcycle is.
+//
+//   frame: 'A' 'L' id(u16) n(u8) n x raised(u64, simulator time steps)
+//
+// The raise times are simulator time, only there for the AP's measurement.
+static const uint16_t ALARM_PORT = 9990;
+static const uint32_t ALARM_BYTES = 13; // one alarm, what the slots are sized to
+uint32_t nAlarms = 0;
+uint32_t nAlarmFrames = 0;
+uint32_t nAlarmsLost = 0;           // raised by a station that died before its slot
+std::vector<double> g_alarmLatency; // s, raised to received at the AP
+
+static uint32_t
+RetxHash (uint32_t id, uint32_t cycle)
+{
+  uint32_t h = id * 2654435761u ^ cycle * 40503u;
+  return h ^ (h >> 16);
+}
+
+static uint64_t
+MacToInt (Mac48Address mac)
+{
+  uint8_t buf[6];
+  mac.CopyTo (buf);
+  uint64_t v = 0;
+  for (int i = 0; i < 6; i++)
+    {
+      v = (v << 8) | buf[i];
+    }
+  return v;
+}
+
 class apApp : public Application
 {
 public:
-//    apApp(){}
+    apApp ();
 //    ~apApp(){}
+    void SetSlotMap (bool enable, Time interval);
+    void SetSync (Time interval);
+    void SetSuperframe (bool enable, Time cycle, Time minWindow, Time maxWindow, Time joinCost);
+    void SetRetx (uint32_t slots, Time width, bool nack, Time cycle, uint32_t nWifi);
+    void SetChurn (Time lease, Time compactInterval, Time cycle, double tslot);
+    void SetAdaptiveCycle (bool enable, Time cycle, Time slot, double targetUtil, Time minCycle, Time maxCycle, Time guard);
+    void SetVarSlots (bool enable, SlotPhy phy, Time guard, Time cycle, bool ack);
+    void SetGroupAck (bool enable, Time cycle);
+    void SetAlarms (bool enable);
+    void DataReceived (Ptr<const Packet> p, const Address &from); // renews the lease, marks the group ACK
 private:
 
     virtual void StartApplication (void);
-    virtual void StopApplication (void){}
+    virtual void StopApplication (void);
 
     Ptr<Socket> m_socket;
 
     Ptr<WifiNetDevice> m_device;
     Ptr<ApWifiMac> m_mac;
     std::set<int> ids;
+    std::map<Mac48Address, int> m_assigned; // STA MAC -> id
+
+    // slot map mode: assignments are collected and broadcast every
+    // m_mapInterval instead of answered one by one
+    bool m_slotMap;
+    Time m_mapInterval;
+    Ptr<Socket> m_mapSocket;
+    EventId m_mapEvent;
+    std::vector< std::pair<uint64_t, uint16_t> > m_pending;
+
+    // sync beacons on the data channel, zero interval disables them
+    Time m_syncInterval;
+    Ptr<Socket> m_syncSocket;
+    EventId m_syncEvent;
+
+    // superframe mode: the join window follows the smoothed number of ID
+    // requests per cycle, joinCost of airtime each
+    bool m_superframe;
+    Time m_cycle;
+    Time m_minWindow;
+    Time m_maxWindow;
+    Time m_joinCost;
+    uint32_t m_joinRequests;
+    double m_joinPressure;
+    Ptr<Socket> m_frameSocket;
+    EventId m_frameEvent;
+    Time m_curWindow;  // join window of the running cycle
+    Time m_nextWindow;
+
+    // retransmission pool; NACK mode maps failed receptions to slot owners
+    uint32_t m_retxSlots;
+    Time m_retxWidth;
+    bool m_retxNack;
+    uint32_t m_nWifi;
+    std::set<uint32_t> m_nacks;
+    Ptr<Socket> m_nackSocket;
+    EventId m_nackEvent;
+
+    // leases: an ID not heard from for m_lease goes back to the pool
+    Time m_lease;
+    Time m_compactInterval;
+    double m_tslot;
+    std::map<int, Mac48Address> m_owner; // id -> STA MAC
+    std::map<int, Time> m_lastHeard;
+    EventId m_leaseEvent;
+    EventId m_compactEvent;
+
+    // compaction handoff: a moved STA that missed the map still sends on
+    // its old ID, so that stays reserved and the move is announced every
+    // cycle until the STA is heard on the new one
+    std::map<int, int> m_movedTo;   // old id -> new id
+    std::map<int, int> m_movedFrom; // new id -> old id
+    EventId m_moveEvent;
+
+    // adaptive cycle: the schedule running since m_epoch, and the one
+    // announced to start at the next boundary
+    bool m_adaptive;
+    double m_targetUtil;
+    Time m_minCycle;
+    Time m_maxCycle;
+    Time m_guard;
+    Time m_slotWidth;
+    Time m_nextCycle;
+    Time m_nextWidth;
+    Time m_rxBegin;
+    Ptr<Socket> m_cycleSocket;
+    EventId m_cycleEvent;
+
+    // variable slots: offset of each ID's slot, next free offset
+    bool m_varSlots;
+    SlotPhy m_varPhy;
+    Time m_varGuard;
+    Time m_varNext;
+    std::map<int, Time> m_varOffset;
+    bool m_varAck;
+
+    // group ACK: IDs heard from in the running cycle
+    bool m_groupAck;
+    std::set<int> m_heard;
+    Ptr<Socket> m_ackSocket;
+    EventId m_ackEvent;
+
+    bool m_alarms;
+    Ptr<Socket> m_alarmSocket;
 
 //    bool ConnectionRequested(Ptr<Socket> socket, const Address& address);
 //    void ConnectionAccepted(Ptr<Socket> socket, const Address& address);
 
     void RequestId(Ptr<Socket> socket);
+    void BroadcastSlotMap (void);
+    void BroadcastSync (void);
+    void BroadcastSuperframe (void);
+    void BroadcastNack (void);
+    void DataRxDrop (Ptr<const Packet> p);
+    void ExpireLeases (void);
+    void CycleBoundary (void);
+    void DataRxBegin (Ptr<const Packet> p);
+    void DataRxEnd (Ptr<const Packet> p);
+    void Compact (void);
+    void RepeatMoves (void);
+    int HighestId (void) const;
+    void BroadcastGroupAck (void);
+    void ReceiveAlarm (Ptr<Socket> socket);
+    uint32_t SendMapFrames (std::vector< std::pair<uint64_t, uint16_t> > entries);
 };
 
+apApp::apApp ()
+  : m_slotMap (false),
+    m_mapInterval (MilliSeconds (100)),
+    m_syncInterval (Seconds (0)),
+    m_superframe (false),
+    m_joinRequests (0),
+    m_joinPressure (0),
+    m_retxSlots (0),
+    m_retxNack (false),
+    m_nWifi (1),
+    m_lease (Seconds (0)),
+    m_compactInterval (Seconds (0)),
+    m_tslot (100),
+    m_adaptive (false),
+    m_targetUtil (0.5),
+    m_varSlots (false),
+    m_varAck (true),
+    m_groupAck (false),
+    m_alarms (false)
+{
+}
+
+void apApp::SetSlotMap (bool enable, Time interval)
+{
+    m_slotMap = enable;
+    m_mapInterval = interval;
+}
+
+void apApp::SetSync (Time interval)
+{
+    m_syncInterval = interval;
+}
+
+void apApp::SetSuperframe (bool enable, Time cycle, Time minWindow, Time maxWindow, Time joinCost)
+{
+    m_superframe = enable;
+    m_cycle = cycle;
+    m_minWindow = minWindow;
+    m_maxWindow = maxWindow;
+    m_joinCost = joinCost;
+    m_curWindow = m_nextWindow = minWindow;
+}
+
+void apApp::SetRetx (uint32_t slots, Time width, bool nack, Time cycle, uint32_t nWifi)
+{
+    m_retxSlots = slots;
+    m_retxWidth = width;
+    m_retxNack = nack;
+    m_cycle = cycle;
+    m_nWifi = nWifi;
+}
+
+void apApp::SetChurn (Time lease, Time compactInterval, Time cycle, double tslot)
+{
+    m_lease = lease;
+    m_compactInterval = compactInterval;
+    m_cycle = cycle;
+    m_tslot = tslot;
+}
+
+void apApp::SetAdaptiveCycle (bool enable, Time cycle, Time slot, double targetUtil, Time minCycle, Time maxCycle, Time guard)
+{
+    m_adaptive = enable;
+    m_cycle = cycle;
+    m_slotWidth = slot;
+    m_targetUtil = targetUtil;
+    m_minCycle = minCycle;
+    m_maxCycle = maxCycle;
+    m_guard = guard;
+}
+
+void apApp::SetVarSlots (bool enable, SlotPhy phy, Time guard, Time cycle, bool ack)
+{
+    m_varSlots = enable;
+    m_varPhy = phy;
+    m_varGuard = guard;
+    m_cycle = cycle;
+    m_varAck = ack;
+}
+
+void apApp::SetGroupAck (bool enable, Time cycle)
+{
+    m_groupAck = enable;
+    m_cycle = cycle;
+}
+
+void apApp::SetAlarms (bool enable)
+{
+    m_alarms = enable;
+}
+
 void apApp::StartApplication ()
 {
     m_device = StaticCast<WifiNetDevice>(m_node->GetDevice(0));
@@ -64,6 +408,449 @@ void apApp::StartApplication ()
     m_socket=Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
     m_socket->SetRecvCallback (MakeCallback(&apApp::RequestId, this));
     m_socket->Bind (apAddress);
+
+    if (m_slotMap || m_lease.IsStrictlyPositive ())
+      {
+        // compaction announces the new IDs as a slot map
+        m_mapSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_mapSocket->SetAllowBroadcast (true);
+        m_mapSocket->BindToNetDevice (m_device);
+        m_mapSocket->Bind ();
+      }
+    if (m_slotMap)
+      {
+        m_mapEvent = ScheduleNamed ("apApp::BroadcastSlotMap", m_mapInterval, &apApp::BroadcastSlotMap, this);
+      }
+    if (m_lease.IsStrictlyPositive ())
+      {
+        m_leaseEvent = ScheduleNamed ("apApp::ExpireLeases", m_cycle, &apApp::ExpireLeases, this);
+        if (m_compactInterval.IsStrictlyPositive ())
+          {
+            m_compactEvent = ScheduleNamed ("apApp::Compact", m_compactInterval, &apApp::Compact, this);
+          }
+      }
+
+    if (m_syncInterval.IsStrictlyPositive ())
+      {
+        m_syncSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_syncSocket->SetAllowBroadcast (true);
+        m_syncSocket->BindToNetDevice (m_node->GetDevice (1));
+        m_syncSocket->Bind ();
+        m_syncEvent = ScheduleNamed ("apApp::BroadcastSync", m_syncInterval, &apApp::BroadcastSync, this);
+      }
+
+    if (m_superframe)
+      {
+        // every STA is associated on the join device before it asks for an ID
+        m_frameSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_frameSocket->SetAllowBroadcast (true);
+        m_frameSocket->BindToNetDevice (m_device);
+        m_frameSocket->Bind ();
+        int64_t cycle = m_cycle.GetTimeStep ();
+        Time next = TimeStep ((Simulator::Now ().GetTimeStep () / cycle + 1) * cycle);
+        m_frameEvent = ScheduleNamed ("apApp::BroadcastSuperframe", next - Simulator::Now (), &apApp::BroadcastSuperframe, this);
+      }
+
+    if (m_adaptive)
+      {
+        Ptr<WifiPhy> phy = StaticCast<WifiNetDevice>(m_node->GetDevice(1))->GetMac()->GetWifiPhy();
+        phy->TraceConnectWithoutContext ("PhyRxBegin", MakeCallback (&apApp::DataRxBegin, this));
+        phy->TraceConnectWithoutContext ("PhyRxEnd", MakeCallback (&apApp::DataRxEnd, this));
+        m_cycleSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_cycleSocket->SetAllowBroadcast (true);
+        m_cycleSocket->BindToNetDevice (m_device);
+        m_cycleSocket->Bind ();
+        // the initial schedule is the configured one on the grid from zero
+        m_nextWidth = m_slotWidth;
+        m_nextCycle = m_cycle;
+        int64_t cycle = m_cycle.GetTimeStep ();
+        Time next = TimeStep ((Simulator::Now ().GetTimeStep () / cycle + 1) * cycle);
+        m_cycleEvent = ScheduleNamed ("apApp::CycleBoundary", next - Simulator::Now (), &apApp::CycleBoundary, this);
+      }
+
+    if (m_groupAck)
+      {
+        m_ackSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_ackSocket->SetAllowBroadcast (true);
+        m_ackSocket->BindToNetDevice (m_node->GetDevice (1));
+        m_ackSocket->Bind ();
+        int64_t cycle = m_cycle.GetTimeStep ();
+        Time next = TimeStep ((Simulator::Now ().GetTimeStep () / cycle + 1) * cycle);
+        m_ackEvent = ScheduleNamed ("apApp::BroadcastGroupAck", next - Simulator::Now (), &apApp::BroadcastGroupAck, this);
+      }
+
+    if (m_alarms)
+      {
+        m_alarmSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_alarmSocket->SetRecvCallback (MakeCallback (&apApp::ReceiveAlarm, this));
+        m_alarmSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), ALARM_PORT));
+      }
+
+    if (m_retxSlots > 0 && m_retxNack)
+      {
+        Ptr<WifiNetDevice> data = StaticCast<WifiNetDevice>(m_node->GetDevice(1));
+        data->GetMac()->GetWifiPhy()->TraceConnectWithoutContext ("PhyRxDrop", MakeCallback (&apApp::DataRxDrop, this));
+        m_nackSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        m_nackSocket->SetAllowBroadcast (true);
+        m_nackSocket->BindToNetDevice (data);
+        m_nackSocket->Bind ();
+        // the list goes out in the first slot of the pool
+        int64_t cycle = m_cycle.GetTimeStep ();
+        int64_t pool = (m_retxSlots + 1) * m_retxWidth.GetTimeStep ();
+        int64_t next = (Simulator::Now ().GetTimeStep () / cycle + 1) * cycle - pool;
+        if (next <= Simulator::Now ().GetTimeStep ())
+          {
+            next += cycle;
+          }
+        m_nackEvent = ScheduleNamed ("apApp::BroadcastNack", TimeStep (next) - Simulator::Now (), &apApp::BroadcastNack, this);
+      }
+}
+
+void apApp::StopApplication ()
+{
+    Simulator::Cancel (m_mapEvent);
+    Simulator::Cancel (m_syncEvent);
+    Simulator::Cancel (m_frameEvent);
+    Simulator::Cancel (m_nackEvent);
+    Simulator::Cancel (m_leaseEvent);
+    Simulator::Cancel (m_compactEvent);
+    Simulator::Cancel (m_moveEvent);
+    Simulator::Cancel (m_cycleEvent);
+    Simulator::Cancel (m_ackEvent);
+}
+
+void apApp::DataRxBegin (Ptr<const Packet> p)
+{
+    m_rxBegin = Simulator::Now ();
+}
+
+void apApp::DataRxEnd (Ptr<const Packet> p)
+{
+    double airtime = (Simulator::Now () - m_rxBegin).GetSeconds ();
+    g_airtime = g_airtime > 0 ? 0.9 * g_airtime + 0.1 * airtime : airtime;
+}
+
+void apApp::CycleBoundary ()
+{
+    // the schedule announced last boundary starts now
+    if (m_nextCycle != m_cycle || m_nextWidth != m_slotWidth)
+      {
+        nCycleChanges++;
+      }
+    m_cycle = m_nextCycle;
+    m_slotWidth = m_nextWidth;
+    g_cycleSum += m_cycle.GetSeconds ();
+
+    // one slot per assigned ID (slot 0 unused), each wide enough that the
+    // frame fills m_targetUtil of it but never less than frame plus guard
+    if (g_airtime > 0)
+      {
+        int highest = std::max (1, HighestId ());
+        Time airtime = Seconds (g_airtime);
+        m_nextWidth = Max (Seconds (g_airtime / m_targetUtil), airtime + m_guard);
+        m_nextCycle = Max (m_minCycle, Min (m_maxCycle, TimeStep (m_nextWidth.GetTimeStep () * (highest + 1))));
+        m_nextWidth = Min (m_nextWidth, TimeStep (m_nextCycle.GetTimeStep () / (highest + 1)));
+      }
+
+    uint8_t frame[26] = {'C', 'Y'};
+    uint64_t fields[3] = {(Simulator::Now () + m_cycle).GetTimeStep (), m_nextCycle.GetTimeStep (), m_nextWidth.GetTimeStep ()};
+    for (int f = 0; f < 3; f++)
+      {
+        for (int b = 0; b < 8; b++)
+          {
+            frame[2 + 8 * f + b] = (fields[f] >> (8 * (7 - b))) & 0xFF;
+          }
+      }
+    Ptr<Packet> packet = Create<Packet> (frame, 26);
+    m_cycleSocket->SendTo (packet, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), CYCLE_PORT));
+    nCycleAnnouncements++;
+    m_cycleEvent = ScheduleNamed ("apApp::CycleBoundary", m_cycle, &apApp::CycleBoundary, this);
+}
+
+void apApp::DataReceived (Ptr<const Packet> p, const Address &from)
+{
+    // payload: attempt, id (u16)
+    uint8_t head[3];
+    if (p->CopyData (head, 3) < 3)
+      {
+        return;
+      }
+    int id = (head[1] << 8) | head[2];
+    std::map<int, int>::iterator from = m_movedFrom.find (id);
+    if (from != m_movedFrom.end ())
+      {
+        // heard on its new ID: the old one can go back to the pool
+        m_movedTo.erase (from->second);
+        m_movedFrom.erase (from);
+      }
+    // still on its old ID: the lease is the new one's
+    std::map<int, int>::iterator to = m_movedTo.find (id);
+    int lease = to != m_movedTo.end () ? to->second : id;
+    if (ids.find (lease) != ids.end ())
+      {
+        m_lastHeard[lease] = Simulator::Now ();
+      }
+    if (m_groupAck)
+      {
+        m_heard.insert (id);
+      }
+}
+
+void apApp::BroadcastGroupAck ()
+{
+    // covers the cycle that just ended, IDs 1 up to the highest assigned
+    uint32_t cycle = Simulator::Now ().GetTimeStep () / m_cycle.GetTimeStep () - 1;
+    uint32_t last = HighestId ();
+    uint32_t perFrame = (GROUP_ACK_MAX_BYTES - 10) * 8;
+    for (uint32_t first = 1; first <= last; first += perFrame)
+      {
+        uint32_t n = std::min (perFrame, last - first + 1);
+        std::vector<uint8_t> frame (10 + (n + 7) / 8, 0);
+        frame[0] = 'G';
+        frame[1] = 'A';
+        for (int b = 0; b < 4; b++)
+          {
+            frame[2 + b] = (cycle >> (8 * (3 - b))) & 0xFF;
+          }
+        frame[6] = first >> 8;
+        frame[7] = first & 0xFF;
+        frame[8] = n >> 8;
+        frame[9] = n & 0xFF;
+        for (uint32_t i = 0; i < n; i++)
+          {
+            if (m_heard.count (first + i))
+              {
+                frame[10 + i / 8] |= 0x80 >> (i % 8);
+              }
+          }
+        Ptr<Packet> packet = Create<Packet> (&frame[0], frame.size ());
+        m_ackSocket->SendTo (packet, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), GROUP_ACK_PORT));
+        nGroupAckFrames++;
+        nGroupAckBytes += frame.size ();
+      }
+    m_heard.clear ();
+    m_ackEvent = ScheduleNamed ("apApp::BroadcastGroupAck", m_cycle, &apApp::BroadcastGroupAck, this);
+}
+
+void apApp::ReceiveAlarm (Ptr<Socket> socket)
+{
+    Ptr<Packet> packet;
+    while ((packet = socket->Recv ()))
+      {
+        std::vector<uint8_t> frame (packet->GetSize ());
+        if (frame.size () < 5)
+          {
+            continue;
+          }
+        packet->CopyData (&frame[0], frame.size ());
+        uint32_t n = frame[4];
+        if (frame[0] != 'A' || frame[1] != 'L' || frame.size () < 5 + 8 * n)
+          {
+            continue;
+          }
+        nAlarmFrames++;
+        for (uint32_t i = 0; i < n; i++)
+          {
+            uint64_t raised = 0;
+            for (int b = 0; b < 8; b++)
+              {
+                raised = (raised << 8) | frame[5 + 8 * i + b];
+              }
+            g_alarmLatency.push_back ((Simulator::Now () - TimeStep (raised)).GetSeconds ());
+          }
+      }
+}
+
+void apApp::ExpireLeases ()
+{
+    for (std::map<int, Time>::iterator i = m_lastHeard.begin (); i != m_lastHeard.end (); )
+      {
+        if (Simulator::Now () - i->second < m_lease)
+          {
+            i++;
+            continue;
+          }
+        std::map<int, int>::iterator from = m_movedFrom.find (i->first);
+        if (from != m_movedFrom.end ())
+          {
+            m_movedTo.erase (from->second);
+            m_movedFrom.erase (from);
+          }
+        ids.erase (i->first);
+        m_assigned.erase (m_owner[i->first]);
+        m_owner.erase (i->first);
+        m_lastHeard.erase (i++);
+        nReclaimed++;
+      }
+    int highest = HighestId ();
+    g_effCycleSum += highest * m_tslot / 1000;
+    nEffCycleSamples++;
+    m_leaseEvent = ScheduleNamed ("apApp::ExpireLeases", m_cycle, &apApp::ExpireLeases, this);
+}
+
+void apApp::Compact ()
+{
+    // one compaction at a time: the last one's moves are not all heard yet
+    if (!m_movedTo.empty ())
+      {
+        m_compactEvent = ScheduleNamed ("apApp::Compact", m_compactInterval, &apApp::Compact, this);
+        return;
+      }
+    // the highest IDs move down into the lowest holes; their old IDs stay
+    // reserved until each STA is heard on its new one
+    std::vector< std::pair<uint64_t, uint16_t> > moved;
+    int hole = 1;
+    while (!ids.empty ())
+      {
+        while (ids.find (hole) != ids.end () || m_movedTo.find (hole) != m_movedTo.end ())
+          {
+            hole++;
+          }
+        int top = *ids.rbegin ();
+        if (hole > top)
+          {
+            break;
+          }
+        Mac48Address sta = m_owner[top];
+        ids.erase (top);
+        ids.insert (hole);
+        m_owner.erase (top);
+        m_owner[hole] = sta;
+        m_lastHeard[hole] = m_lastHeard[top];
+        m_lastHeard.erase (top);
+        m_assigned[sta] = hole;
+        m_movedTo[top] = hole;
+        m_movedFrom[hole] = top;
+        moved.push_back (std::make_pair (MacToInt (sta), hole));
+      }
+    if (!moved.empty ())
+      {
+        nCompactions++;
+        nCompactionBytes += SendMapFrames (moved);
+        Simulator::Cancel (m_moveEvent);
+        m_moveEvent = ScheduleNamed ("apApp::RepeatMoves", m_cycle, &apApp::RepeatMoves, this);
+      }
+    m_compactEvent = ScheduleNamed ("apApp::Compact", m_compactInterval, &apApp::Compact, this);
+}
+
+void apApp::RepeatMoves ()
+{
+    if (m_movedFrom.empty ())
+      {
+        return;
+      }
+    std::vector< std::pair<uint64_t, uint16_t> > moved;
+    for (std::map<int, int>::iterator i = m_movedFrom.begin (); i != m_movedFrom.end (); i++)
+      {
+        moved.push_back (std::make_pair (MacToInt (m_owner[i->first]), i->first));
+      }
+    nCompactionBytes += SendMapFrames (moved);
+    m_moveEvent = ScheduleNamed ("apApp::RepeatMoves", m_cycle, &apApp::RepeatMoves, this);
+}
+
+// Highest slot in use, counting old IDs moved STAs may still send on
+int apApp::HighestId () const
+{
+    int highest = ids.empty () ? 0 : *ids.rbegin ();
+    return m_movedTo.empty () ? highest : std::max (highest, m_movedTo.rbegin ()->first);
+}
+
+uint32_t apApp::SendMapFrames (std::vector< std::pair<uint64_t, uint16_t> > entries)
+{
+    uint32_t bytes = 0;
+    std::vector< std::vector<uint8_t> > frames = SlotMapEncode (entries, SLOT_MAP_MAX_BYTES);
+    for (uint32_t i = 0; i < frames.size (); i++)
+      {
+        Ptr<Packet> packet = Create<Packet> (&frames[i][0], frames[i].size ());
+        m_mapSocket->SendTo (packet, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), SLOT_MAP_PORT));
+        nIdFrames++;
+        nIdFrameBytes += frames[i].size ();
+        bytes += frames[i].size ();
+      }
+    return bytes;
+}
+
+void apApp::DataRxDrop (Ptr<const Packet> p)
+{
+    // whose slot was it: same grid as staApp::GetSlotOffset
+    int64_t cycle = m_cycle.GetTimeStep ();
+    int64_t t = Simulator::Now ().GetTimeStep () % cycle;
+    int64_t window = m_superframe ? m_curWindow.GetTimeStep () : 0;
+    int64_t region = cycle - window - (m_retxSlots + 1) * m_retxWidth.GetTimeStep ();
+    if (region < (int64_t) m_nWifi || t < window || t >= window + region)
+      {
+        return;
+      }
+    m_nacks.insert ((t - window) / (region / m_nWifi) + 1);
+}
+
+void apApp::BroadcastNack ()
+{
+    std::vector<uint8_t> frame;
+    frame.push_back ('N');
+    frame.push_back ('K');
+    frame.push_back (m_nacks.size () >> 8);
+    frame.push_back (m_nacks.size () & 0xFF);
+    for (std::set<uint32_t>::iterator i = m_nacks.begin (); i != m_nacks.end (); i++)
+      {
+        frame.push_back (*i >> 8);
+        frame.push_back (*i & 0xFF);
+      }
+    nNacked += m_nacks.size ();
+    m_nacks.clear ();
+    Ptr<Packet> packet = Create<Packet> (&frame[0], frame.size ());
+    m_nackSocket->SendTo (packet, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), RETX_PORT));
+    m_nackEvent = ScheduleNamed ("apApp::BroadcastNack", m_cycle, &apApp::BroadcastNack, this);
+}
+
+void apApp::BroadcastSuperframe ()
+{
+    m_joinPressure = 0.5 * m_joinPressure + 0.5 * m_joinRequests;
+    m_joinRequests = 0;
+    Time window = TimeStep ((int64_t) (m_joinCost.GetTimeStep () * m_joinPressure));
+    window = Max (m_minWindow, Min (m_maxWindow, window));
+
+    // sent at the start of cycle k, takes effect in cycle k + 1
+    uint32_t cycle = Simulator::Now ().GetTimeStep () / m_cycle.GetTimeStep () + 1;
+    uint32_t windowUs = window.GetMicroSeconds ();
+    uint8_t frame[10] = {'S', 'F'};
+    for (int b = 0; b < 4; b++)
+      {
+        frame[2 + b] = (cycle >> (8 * (3 - b))) & 0xFF;
+        frame[6 + b] = (windowUs >> (8 * (3 - b))) & 0xFF;
+      }
+    Ptr<Packet> packet = Create<Packet> (frame, 10);
+    m_frameSocket->SendTo (packet, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), SUPERFRAME_PORT));
+
+    m_curWindow = m_nextWindow;
+    m_nextWindow = window;
+    nSuperframes++;
+    g_joinWindowSum += window.GetSeconds ();
+    g_joinWindowMax = std::max (g_joinWindowMax, window.GetSeconds ());
+    m_frameEvent = ScheduleNamed ("apApp::BroadcastSuperframe", m_cycle, &apApp::BroadcastSuperframe, this);
+}
+
+void apApp::BroadcastSlotMap ()
+{
+    SendMapFrames (m_pending);
+    m_pending.clear ();
+    m_mapEvent = ScheduleNamed ("apApp::BroadcastSlotMap", m_mapInterval, &apApp::BroadcastSlotMap, this);
+}
+
+void apApp::BroadcastSync ()
+{
+    // our time when the beacon leaves the app; queueing and airtime on the
+    // way to the STA are the sync error
+    uint8_t stamp[8];
+    uint64_t now = Simulator::Now ().GetTimeStep ();
+    for (int b = 0; b < 8; b++)
+      {
+        stamp[b] = (now >> (8 * (7 - b))) & 0xFF;
+      }
+    Ptr<Packet> packet = Create<Packet> (stamp, 8);
+    m_syncSocket->SendTo (packet, 0, InetSocketAddress (Ipv4Address::GetBroadcast (), SYNC_PORT));
+    nSyncBeacons++;
+    m_syncEvent = ScheduleNamed ("apApp::BroadcastSync", m_syncInterval, &apApp::BroadcastSync, this);
 }
 
 void apApp::RequestId (Ptr<Socket> socket)
@@ -71,17 +858,66 @@ void apApp::RequestId (Ptr<Socket> socket)
     Address addr;
     Ptr<Packet> receivedPacket;
     receivedPacket = socket->RecvFrom(addr);
+    m_joinRequests++;
+
+    // the request carries the STA MAC: a retransmitted request, or one whose
+    // reply got lost, is answered with the ID that STA already has
+    uint8_t request[8] = {0};
+    receivedPacket->CopyData (request, 8);
+    Mac48Address sta;
+    sta.CopyFrom (request);
 
-    // get next id
     int id=1;
-    while(ids.find(id)!=ids.end())
-    {
-        id++;
-    }
+    std::map<Mac48Address, int>::iterator assigned = m_assigned.find (sta);
+    if (assigned != m_assigned.end ())
+      {
+        id = assigned->second;
+        nIdRepeated++;
+      }
+    else
+      {
+        // get next id
+        // nor an ID a moved STA may still be sending on
+        while(ids.find(id)!=ids.end() || m_movedTo.find(id)!=m_movedTo.end())
+        {
+            id++;
+        }
+        ids.insert (id);
+        m_assigned[sta] = id;
+      }
+    m_owner[id] = sta;
+    m_lastHeard[id] = Simulator::Now ();
+
+    if (m_slotMap)
+      {
+        // announced with the next map; a repeated request announces again
+        m_pending.push_back (std::make_pair (MacToInt (sta), id));
+        return;
+      }
 
     std::string sid=boost::lexical_cast<std::string>(id);
+    if (m_varSlots)
+      {
+        if (m_varOffset.find (id) == m_varOffset.end ())
+          {
+            uint32_t payload = (request[6] << 8) | request[7];
+            double airtime = SlotAirtimeSeconds (m_varPhy, payload, m_varAck) + m_varGuard.GetSeconds ();
+            m_varOffset[id] = m_varNext;
+            m_varNext += Seconds (airtime);
+            if (m_varNext > m_cycle)
+              {
+                nVarOverflow++;
+              }
+            nVarSlots++;
+            g_varAirtime += airtime;
+            g_varMaxSlot = std::max (g_varMaxSlot, airtime);
+          }
+        sid += " " + boost::lexical_cast<std::string>(m_varOffset[id].GetTimeStep ());
+      }
     Ptr<Packet> packet = Create<Packet> ((const uint8_t*)sid.c_str (),sid.size());
     socket->SendTo(packet,0,addr);
+    nIdFrames++;
+    nIdFrameBytes += sid.size ();
 
   /* THIS PART NEEDS TO CHANGE */
 
@@ -95,6 +931,17 @@ public:
     staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1, uint32_t id,  uint32_t packetSize, uint32_t nPackets, uint32_t nWifi);
     void SetSlotTime(double tslot);
     void SetCycle (uint32_t Tcycle);
+    void SetIdRetry (Time timeout, Time maxBackoff, uint32_t maxRetries);
+    void SetSlotMap (bool enable);
+    void SetClock (double driftPpm);
+    void SetSuperframe (bool enable, Time minWindow);
+    void SetRetx (uint32_t slots, Time width, bool nack);
+    void SetChurn (Time meanLifetime, Time meanDowntime);
+    void SetAdaptiveCycle (bool enable);
+    void SetVarSlots (bool enable);
+    void SetAggregation (Time readingInterval, uint32_t maxBuffered);
+    void SetGroupAck (bool enable);
+    void SetAlarms (Time meanInterval, Time frame, uint32_t k, uint32_t slots, Time width);
 //    virtual ~staApp(){}
 
 private:
@@ -107,10 +954,48 @@ private:
 
     void ScheduleRequestId();
     void RequestId(); // funtion requesting id from AP
+    void RetryRequestId(); // no reply before the backoff expired
     void UpdateId(Ptr<Socket> socket); // callback receiving id from AP
+    void ReceiveSlotMap(Ptr<Socket> socket); // slot map mode: look for our MAC
+    void SetId(uint32_t id);
+    void ReceiveSync(Ptr<Socket> socket); // AP time beacon
+    void ReceiveSuperframe(Ptr<Socket> socket); // next join window length
+
+    int64_t GetJoinWindow (int64_t cycle) const;
+    int64_t GetSlotOffset (int64_t cycle) const; // our slot within cycle
+    Time GetJoinDelay (void); // to a random point of the next join window
+    int64_t GetLocalNow (void) const;
+    Time GetDelayTo (int64_t local) const; // simulator delay to a local time
+
+    void DataTxFailed (Mac48Address to); // MAC gave up on our data frame
+    void ReceiveNack (Ptr<Socket> socket);
+    int64_t GetRetxPool (void) const;
+    void ScheduleRetx (int32_t slot); // -1: claim by hash
+    void SendRetx (void);
 
     void SendPacket(void);
     void ScheduleTx(void);
+    void DataLinkUp(void);
+    bool OnGrid(void) const; // slots at fixed cycle offsets, not relative to the last tx
+    Ptr<Packet> MakeData(uint8_t attempt);
+
+    void ReceiveCycle(Ptr<Socket> socket); // schedule for the next boundary
+    void AdoptSchedule(int64_t local); // switch once the boundary has passed
+    int64_t GetCycleLength(void) const;
+    int64_t GetSlotWidth(void) const;
+
+    void SampleReading(void); // the sensor produced a reading
+
+    void ReceiveGroupAck(Ptr<Socket> socket);
+    void DiscardData(Ptr<Socket> socket); // other stations' broadcast data
+    Address GetDataAddress(void) const;
+
+    void RaiseAlarm(void); // the sensor tripped
+    void ScheduleAlarm(void); // our slot in the next emergency group
+    void SendAlarm(void);
+
+    void Leave(void); // churn: die silently
+    void Rejoin(void); // churn: reboot and ask for an ID again
 
     Ptr<Node> m_node;
     std::vector< Ptr<Socket> > m_sockets;
@@ -127,6 +1012,86 @@ private:
     uint32_t m_Tcycle;
     uint32_t m_channNum;
 
+    bool m_hasId;
+    uint32_t m_idAttempts;
+    Time m_idTimeout;
+    Time m_idMaxBackoff;
+    uint32_t m_idMaxRetries;
+    EventId m_retryEvent;
+    Ptr<UniformRandomVariable> m_jitter;
+    Time m_started;
+    bool m_slotMap;
+
+    // drifting local clock; without one the STA keeps simulator time
+    Ptr<StationClock> m_clock;
+    Ptr<Socket> m_syncSocket;
+    Time m_slotTarget; // local time of the slot SendPacket is due in
+
+    // superframe mode: joins only in the window at the start of each
+    // cycle, data slots share out the rest
+    bool m_superframe;
+    int64_t m_window;
+    int64_t m_windowPrev;
+    int64_t m_windowFrom; // first cycle m_window applies to
+
+    uint32_t m_retxSlots;
+    int64_t m_retxWidth;
+    bool m_retxNack;
+    bool m_dataOutstanding; // last data frame not yet failed or retransmitted
+    bool m_retxPending;
+    EventId m_retxEvent;
+
+    // churn: exponential lifetime and downtime, zero lifetime disables
+    Time m_meanLifetime;
+    Time m_meanDowntime;
+    Ptr<ExponentialRandomVariable> m_churn;
+    EventId m_churnEvent;
+    bool m_alive;
+    bool m_dataLinkUp;
+    Time m_rejoinedAt; // zero unless waiting for the first frame after a rejoin
+
+    // schedule: cycles of m_cycleLen from m_epoch, slots of m_slotWidth;
+    // zero length or width means the configured Tcycle and tslot
+    bool m_adaptive;
+    int64_t m_epoch;
+    int64_t m_cycleLen;
+    int64_t m_slotWidth;
+    int64_t m_nextEpoch; // zero when nothing is announced
+    int64_t m_nextCycleLen;
+    int64_t m_nextSlotWidth;
+
+    // variable slots: our slot's offset in the cycle as the AP sized it,
+    // negative until the AP answered
+    bool m_varSlots;
+    int64_t m_varOffset;
+
+    // aggregation buffer: readings waiting for a slot, and the batch the
+    // last data frame carried (a retransmission repeats it)
+    Time m_readingInterval;
+    uint32_t m_maxBuffered;
+    uint32_t m_buffered;
+    uint32_t m_batch;
+    EventId m_readingEvent;
+
+    // group ACK: the cycle our outstanding frame went out in; a frame the
+    // bitmap left out goes again in our next slot
+    bool m_groupAck;
+    int64_t m_sentCycle;
+    bool m_groupLost;
+
+    // alarms: one emergency group of m_alarmSlots slots of m_alarmWidth
+    // after the first m_alarmK data slots of every m_alarmFrame; zero frame
+    // disables them. Alarms raised before our slot go out together.
+    Time m_alarmInterval;
+    int64_t m_alarmFrame;
+    uint32_t m_alarmK;
+    uint32_t m_alarmSlots;
+    int64_t m_alarmWidth;
+    Ptr<ExponentialRandomVariable> m_alarm;
+    std::vector<int64_t> m_alarmsRaised;
+    EventId m_alarmEvent;
+    EventId m_alarmTxEvent;
+
     std::vector< Ptr<WifiNetDevice> > m_devices;
     std::vector< Ptr<StaWifiMac> > m_macs;
 };
@@ -142,12 +1107,54 @@ staApp::staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1,uint32_t id,
     m_tslot(0),
     m_nWifi(nWifi),
     m_sendEvent(),
-    m_running(false)
+    m_running(false),
+    m_hasId(false),
+    m_idAttempts(0),
+    m_idTimeout(MilliSeconds(100)),
+    m_idMaxBackoff(Seconds(5)),
+    m_idMaxRetries(6),
+    m_slotMap(false),
+    m_superframe(false),
+    m_window(0),
+    m_windowPrev(0),
+    m_windowFrom(0),
+    m_retxSlots(0),
+    m_retxWidth(0),
+    m_retxNack(false),
+    m_dataOutstanding(false),
+    m_retxPending(false),
+    m_meanLifetime(Seconds(0)),
+    m_meanDowntime(Seconds(0)),
+    m_alive(true),
+    m_dataLinkUp(false),
+    m_adaptive(false),
+    m_epoch(0),
+    m_cycleLen(0),
+    m_slotWidth(0),
+    m_nextEpoch(0),
+    m_nextCycleLen(0),
+    m_nextSlotWidth(0),
+    m_varSlots(false),
+    m_varOffset(-1),
+    m_readingInterval(Seconds(0)),
+    m_maxBuffered(0),
+    m_buffered(0),
+    m_batch(0),
+    m_groupAck(false),
+    m_sentCycle(-1),
+    m_groupLost(false),
+    m_alarmInterval(Seconds(0)),
+    m_alarmFrame(0),
+    m_alarmK(0),
+    m_alarmSlots(0),
+    m_alarmWidth(0)
 {
+    m_jitter = CreateObject<UniformRandomVariable> ();
     m_devices.push_back( StaticCast<WifiNetDevice>(m_node->GetDevice(0)) );
     m_devices.push_back( StaticCast<WifiNetDevice>(m_node->GetDevice(1)) );
     m_macs.push_back (StaticCast<StaWifiMac>(m_devices[0]->GetMac()));
-    m_macs.push_back (StaticCast<StaWifiMac>(m_devices[1]->GetMac()));
+    // null when the data channel runs ad hoc (group ACK)
+    m_macs.push_back (DynamicCast<StaWifiMac>(m_devices[1]->GetMac()));
 
     m_macs[0]->SetLinkUpCallback (MakeCallback(&staApp::ScheduleRequestId,this)); // setup callback for requesting id
 
@@ -159,7 +1166,10 @@ staApp::staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1,uint32_t id,
     m_sockets[0]->SetRecvCallback(MakeCallback(&staApp::UpdateId,this));
     m_sockets[0]->Bind(staAddress0);
 
-    m_macs[1]->SetLinkUpCallback (MakeCallback(&staApp::ScheduleTx,this));
+    if (m_macs[1])
+      {
+        m_macs[1]->SetLinkUpCallback (MakeCallback(&staApp::DataLinkUp,this));
+      }
     Ipv4Address staIpv4Address1=m_node->GetObject<Ipv4>()->GetAddress (2,0).GetLocal();
     staPort = 9998;
     Address staAddress1 (InetSocketAddress (staIpv4Address1, staPort));
@@ -170,9 +1180,25 @@ staApp::staApp (Ptr<Node> node, Ipv4Address addr,Ipv4Address addr1,uint32_t id,
 void
 staApp::StartApplication (void)
 {
-  std::cout<<"START "<<m_id<<" "<<Simulator::Now()<<std::endl;
+  g_trace.Record (IDTDMA_TRACE_START, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id);
+  m_started = Simulator::Now ();
   //RequestId ();
     ScheduleAssociation (0);
+    if (m_meanLifetime.IsStrictlyPositive ())
+      {
+        m_churnEvent = ScheduleNamed ("staApp::Leave", Seconds (m_churn->GetValue (m_meanLifetime.GetSeconds (), 0)), &staApp::Leave, this);
+      }
+    if (g_readingSize > 0)
+      {
+        // sensors are not synchronised with each other
+        m_readingEvent = ScheduleNamed ("staApp::SampleReading", Seconds (m_jitter->GetValue (0, m_readingInterval.GetSeconds ())),
+                                        &staApp::SampleReading, this);
+      }
+    if (m_alarmFrame > 0)
+      {
+        m_alarmEvent = ScheduleNamed ("staApp::RaiseAlarm", Seconds (m_alarm->GetValue (m_alarmInterval.GetSeconds (), 0)),
+                                      &staApp::RaiseAlarm, this);
+      }
 //    ScheduleRequestId ();
 //    Time tstart = MilliSeconds(m_id*m_tslot);
 //    Simulator::Schedule(tstart,&staApp::SendPacket,this);
@@ -187,11 +1213,27 @@ staApp::StopApplication (void)
     {
         Simulator::Cancel (m_sendEvent);
     }
+    Simulator::Cancel (m_retryEvent);
+    Simulator::Cancel (m_retxEvent);
+    Simulator::Cancel (m_churnEvent);
+    Simulator::Cancel (m_readingEvent);
+    Simulator::Cancel (m_alarmEvent);
+    Simulator::Cancel (m_alarmTxEvent);
+    if (m_syncSocket)
+      {
+        m_syncSocket->Close ();
+      }
 }
 
 void staApp::StartAssociation (int device)
 {
-  std::cout<<"SCHED "<<m_id<<" "<<Simulator::Now()<<std::endl;
+  g_trace.Record (IDTDMA_TRACE_SCHED, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id, device);
+    if (!m_macs[device])
+      {
+        // ad hoc: nothing to associate with
+        DataLinkUp ();
+        return;
+      }
     m_macs[device]->SetAttribute ("ActiveProbing",BooleanValue(true));
 //    if (device ==1)
 //      {
@@ -207,11 +1249,16 @@ void staApp::ScheduleAssociation (int device)
 //    tNext+=MilliSeconds(m_id*m_tslot);
 //    Simulator::Schedule (tNext - tNow, &staApp::StartAssociation, this, device);
 //    Time tNext (MilliSeconds(2));
-    m_sendEvent = Simulator::Schedule (MilliSeconds(m_id*m_tslot), &staApp::StartAssociation, this,device);
+    if (m_superframe)
+      {
+        m_sendEvent = ScheduleNamed ("staApp::StartAssociation", GetJoinDelay (), &staApp::StartAssociation, this, device);
+        return;
+      }
+    m_sendEvent = ScheduleNamed ("staApp::StartAssociation", MilliSeconds(m_id*m_tslot), &staApp::StartAssociation, this,device);
     if (device ==1)
       {
         Time tNext (Seconds(m_Tcycle));
-        m_sendEvent = Simulator::Schedule (tNext, &staApp::StartAssociation, this,device);
+        m_sendEvent = ScheduleNamed ("staApp::StartAssociation", tNext, &staApp::StartAssociation, this,device);
       }
 }
 
@@ -222,41 +1269,623 @@ void staApp::ScheduleRequestId()
 //    Time tNext(Seconds(tSec+1)); // start on the next second
 //    tNext+=MilliSeconds(m_id*m_tslot);
 //    Simulator::Schedule (tNext - tNow, &staApp::RequestId, this);
-      Simulator::Schedule (Seconds(m_Tcycle), &staApp::RequestId, this);
+    // a reboot within a Tcycle of the last one must not start a second chain
+    Simulator::Cancel (m_retryEvent);
+    if (m_superframe)
+      {
+        m_retryEvent = ScheduleNamed ("staApp::RequestId", GetJoinDelay (), &staApp::RequestId, this);
+        return;
+      }
+      m_retryEvent = ScheduleNamed ("staApp::RequestId", Seconds(m_Tcycle), &staApp::RequestId, this);
 }
 
 void staApp::RequestId ()
 {
-  std::cout<<"REQU ID "<<m_id<<" "<<Simulator::Now()<<std::endl;
-
-    Ptr<Packet> packet = Create<Packet> (64);
+  if (!m_alive)
+    {
+      return;
+    }
+  g_trace.Record (IDTDMA_TRACE_REQU_ID, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id);
+    Simulator::Cancel (m_retryEvent);
+    // the AP keys the assignment on our MAC and sizes our slot to the payload
+    uint8_t request[64] = {0};
+    Mac48Address::ConvertFrom (m_devices[0]->GetAddress ()).CopyTo (request);
+    request[6] = std::min<uint32_t> (m_packetSize, 0xFFFF) >> 8;
+    request[7] = std::min<uint32_t> (m_packetSize, 0xFFFF) & 0xFF;
+    Ptr<Packet> packet = Create<Packet> (request, 64);
     uint16_t apPort = 9996;
     Address apAddress (InetSocketAddress (m_peer, apPort));
     m_sockets[0]->SendTo(packet,0,apAddress);
+
+    // exponential backoff, half of it random so stations whose requests
+    // collided do not retry in lockstep
+    double backoff = std::min (m_idTimeout.GetSeconds () * std::pow (2.0, m_idAttempts), m_idMaxBackoff.GetSeconds ());
+    Time wait = Seconds (backoff / 2 + m_jitter->GetValue (0, backoff / 2));
+    m_retryEvent = ScheduleNamed ("staApp::RetryRequestId", wait, &staApp::RetryRequestId, this);
 }
 
-void staApp::UpdateId(Ptr<Socket> socket)
+void staApp::RetryRequestId ()
 {
-  std::cout<<"UPD ID "<<m_id<<" "<<Simulator::Now()<<std::endl;
+    if (m_idAttempts >= m_idMaxRetries)
+      {
+        nIdGiveUps++;
+        g_trace.Record (IDTDMA_TRACE_ID_GIVEUP, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id, m_idAttempts + 1);
+        return;
+      }
+    m_idAttempts++;
+    nIdRetries++;
+    g_trace.Record (IDTDMA_TRACE_ID_RETRY, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), m_id, m_idAttempts);
+    if (m_superframe)
+      {
+        m_retryEvent = ScheduleNamed ("staApp::RequestId", GetJoinDelay (), &staApp::RequestId, this);
+        return;
+      }
+    RequestId ();
+}
 
+void staApp::UpdateId(Ptr<Socket> socket)
+{
   Ptr<Packet> packet=socket->Recv ();
   std::ostringstream ostr;
   packet->CopyData(&ostr, packet->GetSize());
-  m_id=boost::lexical_cast<uint32_t>(ostr.str ());
+  // "id", or "id offset" with variable slots
+  std::istringstream istr (ostr.str ());
+  uint32_t id;
+  int64_t offset;
+  istr >> id;
+  if (m_varSlots && istr >> offset)
+    {
+      m_varOffset = offset;
+    }
+  SetId (id);
+}
 
+void staApp::ReceiveSlotMap(Ptr<Socket> socket)
+{
+  uint64_t mac = MacToInt (Mac48Address::ConvertFrom (m_devices[0]->GetAddress ()));
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      std::vector<uint8_t> frame (packet->GetSize ());
+      if (frame.empty ())
+        {
+          continue;
+        }
+      packet->CopyData (&frame[0], frame.size ());
+      uint16_t slot;
+      if (SlotMapLookup (&frame[0], frame.size (), mac, slot))
+        {
+          SetId (slot);
+        }
+    }
+}
 
+void staApp::SetId(uint32_t id)
+{
+  if (!m_alive)
+    {
+      return;
+    }
+  uint32_t oldId = m_id;
+  m_id=id;
+  g_trace.Record (IDTDMA_TRACE_UPD_ID, m_node->GetId (), Simulator::Now ().GetNanoSeconds (), oldId, m_id);
+
+  Simulator::Cancel (m_retryEvent);
+  if (m_hasId)
+    {
+      // late reply to a retransmission, or the AP compacted the schedule
+      if (id != oldId && m_dataLinkUp && m_sendEvent.IsRunning ())
+        {
+          nIdMoved++;
+          Simulator::Cancel (m_sendEvent);
+          ScheduleTx ();
+        }
+      return;
+    }
+  m_hasId = true;
+  nIdAssigned++;
+  g_joinSeconds.push_back ((Simulator::Now () - m_started).GetSeconds ());
 
+  if (m_dataLinkUp)
+    {
+      // rebooted: still associated on the data channel
+      ScheduleTx ();
+      return;
+    }
   ScheduleAssociation (1);
 }
 
+void staApp::SampleReading (void)
+{
+  if (m_alive)
+    {
+      nReadings++;
+      if (m_buffered < m_maxBuffered)
+        {
+          m_buffered++;
+        }
+      else
+        {
+          nReadingsDropped++;
+        }
+    }
+  m_readingEvent = ScheduleNamed ("staApp::SampleReading", m_readingInterval, &staApp::SampleReading, this);
+}
+
+Address staApp::GetDataAddress (void) const
+{
+  if (m_groupAck)
+    {
+      // broadcast frames get no MAC ACK
+      Ipv4InterfaceAddress data = m_node->GetObject<Ipv4> ()->GetAddress (2, 0);
+      return InetSocketAddress (data.GetLocal ().GetSubnetDirectedBroadcast (data.GetMask ()), 9998);
+    }
+  return InetSocketAddress (m_peer1, 9998);
+}
+
+void staApp::RaiseAlarm (void)
+{
+  if (m_alive)
+    {
+      nAlarms++;
+      m_alarmsRaised.push_back (Simulator::Now ().GetTimeStep ());
+      if (!m_alarmTxEvent.IsRunning ())
+        {
+          ScheduleAlarm ();
+        }
+    }
+  m_alarmEvent = ScheduleNamed ("staApp::RaiseAlarm", Seconds (m_alarm->GetValue (m_alarmInterval.GetSeconds (), 0)),
+                                &staApp::RaiseAlarm, this);
+}
+
+void staApp::ScheduleAlarm (void)
+{
+  // alarm frames of this cycle from the grid origin; the slot hash changes
+  // per group so two stations that collided once do not collide again
+  int64_t length = GetCycleLength ();
+  int64_t frames = length / m_alarmFrame;
+  int64_t local = GetLocalNow ();
+  int64_t cycle = (local - m_epoch) / length;
+  for (int64_t frame = (local - m_epoch - cycle * length) / m_alarmFrame; ; frame++)
+    {
+      if (frame >= frames)
+        {
+          cycle++;
+          frame = 0;
+        }
+      uint32_t s = RetxHash (m_id, cycle * frames + frame) % m_alarmSlots;
+      int64_t target = m_epoch + cycle * length + frame * m_alarmFrame + m_alarmK * GetSlotWidth () + s * m_alarmWidth;
+      if (target > local)
+        {
+          m_alarmTxEvent = ScheduleNamed ("staApp::SendAlarm", GetDelayTo (target), &staApp::SendAlarm, this);
+          return;
+        }
+    }
+}
+
+void staApp::SendAlarm (void)
+{
+  if (!m_dataLinkUp)
+    {
+      // not associated on the data channel yet: the next group
+      ScheduleAlarm ();
+      return;
+    }
+  uint32_t n = std::min<uint32_t> (m_alarmsRaised.size (), 0xFF);
+  std::vector<uint8_t> frame (5 + 8 * n);
+  frame[0] = 'A';
+  frame[1] = 'L';
+  frame[2] = m_id >> 8;
+  frame[3] = m_id & 0xFF;
+  frame[4] = n;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      for (int b = 0; b < 8; b++)
+        {
+          frame[5 + 8 * i + b] = (m_alarmsRaised[i] >> (8 * (7 - b))) & 0xFF;
+        }
+    }
+  m_alarmsRaised.erase (m_alarmsRaised.begin (), m_alarmsRaised.begin () + n);
+  Ptr<Packet> packet = Create<Packet> (&frame[0], frame.size ());
+  m_sockets[1]->SendTo (packet, 0, InetSocketAddress (m_peer1, ALARM_PORT));
+  if (!m_alarmsRaised.empty ())
+    {
+      ScheduleAlarm ();
+    }
+}
+
+void staApp::DiscardData (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+    }
+}
+
+void staApp::ReceiveGroupAck (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      std::vector<uint8_t> frame (packet->GetSize ());
+      if (frame.size () < 10)
+        {
+          continue;
+        }
+      packet->CopyData (&frame[0], frame.size ());
+      uint32_t cycle = (frame[2] << 24) | (frame[3] << 16) | (frame[4] << 8) | frame[5];
+      uint32_t first = (frame[6] << 8) | frame[7];
+      uint32_t n = (frame[8] << 8) | frame[9];
+      if (frame[0] != 'G' || frame[1] != 'A' || frame.size () < 10 + (n + 7) / 8
+          || !m_dataOutstanding || cycle != m_sentCycle || m_id < first || m_id >= first + n)
+        {
+          continue;
+        }
+      m_dataOutstanding = false;
+      uint32_t i = m_id - first;
+      if (frame[10 + i / 8] & (0x80 >> (i % 8)))
+        {
+          nGroupAcked++;
+          continue;
+        }
+      nGroupLost++;
+      if (m_retxSlots > 0)
+        {
+          m_retxPending = true;
+          ScheduleRetx (-1);
+          continue;
+        }
+      m_groupLost = true;
+      if (!m_sendEvent.IsRunning ())
+        {
+          ScheduleTx ();
+        }
+    }
+}
+
+void staApp::Leave (void)
+{
+  // no goodbye: the AP only notices when the lease runs out
+  m_alive = false;
+  m_hasId = false;
+  Simulator::Cancel (m_sendEvent);
+  Simulator::Cancel (m_retryEvent);
+  Simulator::Cancel (m_retxEvent);
+  m_retxPending = false;
+  m_dataOutstanding = false;
+  m_groupLost = false;
+  nReadingsDropped += m_buffered; // a reboot loses the RAM buffer
+  m_buffered = 0;
+  Simulator::Cancel (m_alarmTxEvent);
+  nAlarmsLost += m_alarmsRaised.size ();
+  m_alarmsRaised.clear ();
+  nLeaves++;
+  m_churnEvent = ScheduleNamed ("staApp::Rejoin", Seconds (m_churn->GetValue (m_meanDowntime.GetSeconds (), 0)), &staApp::Rejoin, this);
+}
+
+void staApp::Rejoin (void)
+{
+  m_alive = true;
+  m_idAttempts = 0;
+  m_packetsSent = 0;
+  m_started = Simulator::Now ();
+  m_rejoinedAt = Simulator::Now ();
+  nRejoins++;
+  // the join channel association survived the reboot in the MAC; if it
+  // never came up, its link-up callback asks for the ID
+  if (m_macs[0]->IsAssociated ())
+    {
+      ScheduleRequestId ();
+    }
+  m_churnEvent = ScheduleNamed ("staApp::Leave", Seconds (m_churn->GetValue (m_meanLifetime.GetSeconds (), 0)), &staApp::Leave, this);
+}
+
+void staApp::ReceiveSync(Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      if (packet->GetSize () != 8)
+        {
+          continue;
+        }
+      uint8_t stamp[8];
+      packet->CopyData (stamp, 8);
+      uint64_t ts = 0;
+      for (int b = 0; b < 8; b++)
+        {
+          ts = (ts << 8) | stamp[b];
+        }
+      m_clock->Sync (Simulator::Now (), TimeStep (ts));
+      g_maxSyncError = std::max (g_maxSyncError, (Simulator::Now () - TimeStep (ts)).GetSeconds ());
+    }
+}
+
+void staApp::ReceiveSuperframe(Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      uint8_t frame[10];
+      if (packet->GetSize () != 10 || packet->CopyData (frame, 10) != 10 || frame[0] != 'S' || frame[1] != 'F')
+        {
+          continue;
+        }
+      uint32_t cycle = 0, windowUs = 0;
+      for (int b = 0; b < 4; b++)
+        {
+          cycle = (cycle << 8) | frame[2 + b];
+          windowUs = (windowUs << 8) | frame[6 + b];
+        }
+      m_windowPrev = GetJoinWindow (cycle - 1);
+      m_window = MicroSeconds (windowUs).GetTimeStep ();
+      m_windowFrom = cycle;
+    }
+}
+
+int64_t staApp::GetJoinWindow (int64_t cycle) const
+{
+  return cycle >= m_windowFrom ? m_window : m_windowPrev;
+}
+
+int64_t staApp::GetCycleLength (void) const
+{
+  return m_cycleLen > 0 ? m_cycleLen : Seconds (m_Tcycle).GetTimeStep ();
+}
+
+int64_t staApp::GetSlotWidth (void) const
+{
+  return m_slotWidth > 0 ? m_slotWidth : MilliSeconds (m_tslot).GetTimeStep ();
+}
+
+void staApp::ReceiveCycle(Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      uint8_t frame[26];
+      if (packet->GetSize () != 26 || packet->CopyData (frame, 26) != 26 || frame[0] != 'C' || frame[1] != 'Y')
+        {
+          continue;
+        }
+      uint64_t fields[3] = {0, 0, 0};
+      for (int f = 0; f < 3; f++)
+        {
+          for (int b = 0; b < 8; b++)
+            {
+              fields[f] = (fields[f] << 8) | frame[2 + 8 * f + b];
+            }
+        }
+      m_nextEpoch = fields[0];
+      m_nextCycleLen = fields[1];
+      m_nextSlotWidth = fields[2];
+    }
+}
+
+void staApp::AdoptSchedule(int64_t local)
+{
+  if (m_nextEpoch == 0 || local < m_nextEpoch)
+    {
+      return;
+    }
+  m_epoch = m_nextEpoch;
+  m_cycleLen = m_nextCycleLen;
+  m_slotWidth = m_nextSlotWidth;
+  m_nextEpoch = 0;
+}
+
+int64_t staApp::GetSlotOffset (int64_t cycle) const
+{
+  int64_t length = GetCycleLength ();
+  if (m_varOffset >= 0)
+    {
+      return m_varOffset % length;
+    }
+  if (m_alarmFrame > 0)
+    {
+      // m_alarmK slots, then the emergency group, in every alarm frame
+      int64_t slots = (length / m_alarmFrame) * m_alarmK;
+      int64_t s = m_id % slots;
+      return (s / m_alarmK) * m_alarmFrame + (s % m_alarmK) * GetSlotWidth ();
+    }
+  if (!m_superframe && m_retxSlots == 0)
+    {
+      // a compacted schedule only spans the IDs actually in use
+      return (m_id * GetSlotWidth ()) % length;
+    }
+  int64_t window = m_superframe ? GetJoinWindow (cycle) : 0;
+  int64_t width = (length - window - GetRetxPool ()) / m_nWifi;
+  return window + (m_id > 0 ? m_id - 1 : 0) * width;
+}
+
+Time staApp::GetJoinDelay (void)
+{
+  int64_t length = Seconds (m_Tcycle).GetTimeStep ();
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  int64_t cycle = now / length;
+  if (now >= cycle * length + GetJoinWindow (cycle))
+    {
+      cycle++;
+    }
+  int64_t from = std::max (now, cycle * length);
+  int64_t to = cycle * length + GetJoinWindow (cycle);
+  return TimeStep (from - now + (int64_t) m_jitter->GetValue (0, to - from));
+}
+
+void staApp::DataLinkUp (void)
+{
+  m_dataLinkUp = true;
+  if (m_alive)
+    {
+      ScheduleTx ();
+    }
+}
+
+bool staApp::OnGrid (void) const
+{
+  return m_clock || m_superframe || m_retxSlots > 0 || m_meanLifetime.IsStrictlyPositive () || m_adaptive || m_varSlots || m_groupAck
+         || m_alarmFrame > 0;
+}
+
+Ptr<Packet> staApp::MakeData (uint8_t attempt)
+{
+  // payload starts with the attempt and our ID, the AP renews our lease on
+  // it; a batch follows with its reading count and the readings
+  uint32_t size = std::max<uint32_t> (3, m_packetSize);
+  if (g_readingSize > 0)
+    {
+      if (attempt == 0)
+        {
+          uint32_t room = (m_packetSize - 5) / g_readingSize;
+          m_batch = std::min (std::min (m_buffered, room), 0xFFFFu);
+          m_buffered -= m_batch;
+        }
+      size = 5 + m_batch * g_readingSize;
+    }
+  std::vector<uint8_t> payload (size, 0);
+  payload[0] = attempt;
+  payload[1] = m_id >> 8;
+  payload[2] = m_id & 0xFF;
+  if (g_readingSize > 0)
+    {
+      payload[3] = m_batch >> 8;
+      payload[4] = m_batch & 0xFF;
+    }
+  return Create<Packet> (&payload[0], payload.size ());
+}
+
+int64_t staApp::GetLocalNow (void) const
+{
+  return (m_clock ? m_clock->GetLocal (Simulator::Now ()) : Simulator::Now ()).GetTimeStep ();
+}
+
+Time staApp::GetDelayTo (int64_t local) const
+{
+  return m_clock ? m_clock->GetDelay (TimeStep (local), Simulator::Now ()) : TimeStep (local) - Simulator::Now ();
+}
+
+int64_t staApp::GetRetxPool (void) const
+{
+  if (m_retxSlots == 0)
+    {
+      return 0;
+    }
+  return (m_retxSlots + (m_retxNack ? 1 : 0)) * m_retxWidth;
+}
+
+void staApp::DataTxFailed (Mac48Address to)
+{
+  if (!m_dataOutstanding)
+    {
+      return;
+    }
+  m_dataOutstanding = false;
+  m_retxPending = true;
+  nDataFailed++;
+  if (!m_retxNack)
+    {
+      ScheduleRetx (-1);
+    }
+}
+
+void staApp::ReceiveNack (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      std::vector<uint8_t> frame (packet->GetSize ());
+      if (frame.size () < 4)
+        {
+          continue;
+        }
+      packet->CopyData (&frame[0], frame.size ());
+      uint32_t n = (frame[2] << 8) | frame[3];
+      if (frame[0] != 'N' || frame[1] != 'K' || frame.size () < 4 + 2 * n || !m_retxPending || m_retxEvent.IsRunning ())
+        {
+          continue;
+        }
+      // listed: our place in the list; not listed: hash over what is left
+      uint32_t pos = n;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          if (((frame[4 + 2 * i] << 8) | frame[5 + 2 * i]) == m_id)
+            {
+              pos = i;
+            }
+        }
+      uint32_t taken = std::min (n, m_retxSlots);
+      if (pos < m_retxSlots)
+        {
+          ScheduleRetx (pos);
+        }
+      else if (pos == n && taken < m_retxSlots)
+        {
+          int64_t cycle = (GetLocalNow () - m_epoch) / GetCycleLength ();
+          ScheduleRetx (taken + RetxHash (m_id, cycle) % (m_retxSlots - taken));
+        }
+      else
+        {
+          m_retxPending = false;
+          nRetxUnclaimed++;
+        }
+    }
+}
+
+void staApp::ScheduleRetx (int32_t slot)
+{
+  int64_t length = GetCycleLength ();
+  int64_t local = GetLocalNow ();
+  for (int64_t cycle = (local - m_epoch) / length; ; cycle++)
+    {
+      uint32_t s = slot >= 0 ? slot : RetxHash (m_id, cycle) % m_retxSlots;
+      int64_t target = m_epoch + (cycle + 1) * length - GetRetxPool () + (m_retxNack ? m_retxWidth : 0) + s * m_retxWidth;
+      if (target > local)
+        {
+          m_retxEvent = ScheduleNamed ("staApp::SendRetx", GetDelayTo (target), &staApp::SendRetx, this);
+          return;
+        }
+    }
+}
+
+void staApp::SendRetx (void)
+{
+    // a failed retransmission is not retried again
+    Ptr<Packet> packet = MakeData (1);
+    m_sockets[1]->SendTo (packet, 0, GetDataAddress ());
+    m_retxPending = false;
+    nRetxSent++;
+}
 
 void staApp::ScheduleTx (void)
 {
+    if (OnGrid ())
+      {
+        // next start of our slot as our own clock sees it, on the cycle
+        // grid that starts at m_epoch
+        int64_t local = GetLocalNow ();
+        AdoptSchedule (local);
+        int64_t length = GetCycleLength ();
+        int64_t cycle = (local - m_epoch) / length;
+        int64_t target = m_epoch + cycle * length + GetSlotOffset (cycle);
+        if (target <= local)
+          {
+            cycle++;
+            target = m_epoch + cycle * length + GetSlotOffset (cycle);
+          }
+        if (m_nextEpoch > 0 && target >= m_nextEpoch)
+          {
+            // a new schedule starts before our slot comes round
+            AdoptSchedule (m_nextEpoch);
+            target = m_epoch + GetSlotOffset (0);
+          }
+        m_slotTarget = TimeStep (target);
+        m_sendEvent = ScheduleNamed ("staApp::SendPacket", GetDelayTo (m_slotTarget.GetTimeStep ()), &staApp::SendPacket, this);
+        return;
+      }
 //    Time tNow=Simulator::Now ();
 //    double tSec=std::round(tNow.GetSeconds ());
 //    Time tNext(Seconds(tSec+1)); // start on the next second
 //    tNext+=MilliSeconds(m_nWifi*m_tslot );
-    m_sendEvent = Simulator::Schedule (Seconds(m_Tcycle), &staApp::SendPacket,this);
+    m_sendEvent = ScheduleNamed ("staApp::SendPacket", Seconds(m_Tcycle), &staApp::SendPacket,this);
 //    Time tNext (MilliSeconds(0));
 //    if (m_packetsSent==0)
 //        {
@@ -273,10 +1902,33 @@ void staApp::ScheduleTx (void)
 
 void staApp::SendPacket (void)
 {
-    Ptr<Packet> packet = Create<Packet> (m_packetSize);
-    uint16_t apPort = 9998;
-    Address apAddress (InetSocketAddress (m_peer1, apPort));
-    m_sockets[1]->SendTo(packet,0,apAddress);
+    if (m_clock)
+      {
+        // the slot really starts at m_slotTarget; we are off by our clock error
+        g_maxSlotError = std::max (g_maxSlotError, std::abs ((Simulator::Now () - m_slotTarget).GetSeconds ()));
+        nSlotSamples++;
+      }
+    if (!m_rejoinedAt.IsZero ())
+      {
+        g_rejoinToData.push_back ((Simulator::Now () - m_rejoinedAt).GetSeconds ());
+        m_rejoinedAt = Seconds (0);
+      }
+    if (m_groupLost)
+      {
+        // the group ACK missed our last frame: this slot repeats it
+        m_groupLost = false;
+        m_sockets[1]->SendTo (MakeData (1), 0, GetDataAddress ());
+        nRetxSent++;
+        if (m_packetsSent < m_nPackets)
+          {
+            ScheduleTx ();
+          }
+        return;
+      }
+    Ptr<Packet> packet = MakeData (0);
+    m_sockets[1]->SendTo(packet,0,GetDataAddress ());
+    m_dataOutstanding = true;
+    m_sentCycle = (m_slotTarget.GetTimeStep () - m_epoch) / GetCycleLength ();
     if (++m_packetsSent<m_nPackets)
     {
         ScheduleTx ();
@@ -293,6 +1945,137 @@ void staApp::SetCycle (uint32_t Tcycle)
     m_Tcycle=Tcycle;
 }
 
+void staApp::SetIdRetry (Time timeout, Time maxBackoff, uint32_t maxRetries)
+{
+    m_idTimeout = timeout;
+    m_idMaxBackoff = maxBackoff;
+    m_idMaxRetries = maxRetries;
+}
+
+void staApp::SetSlotMap (bool enable)
+{
+    m_slotMap = enable;
+    if (m_slotMap && m_sockets.size () == 2)
+      {
+        // broadcasts reach a socket bound to the wildcard address
+        m_sockets.push_back (Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ()));
+        m_sockets[2]->SetRecvCallback (MakeCallback (&staApp::ReceiveSlotMap, this));
+        m_sockets[2]->Bind (InetSocketAddress (Ipv4Address::GetAny (), SLOT_MAP_PORT));
+      }
+}
+
+void staApp::SetClock (double driftPpm)
+{
+    double drift = m_jitter->GetValue (-driftPpm, driftPpm);
+    m_clock = Create<StationClock> (drift);
+    g_maxDriftPpm = std::max (g_maxDriftPpm, std::abs (drift));
+
+    m_syncSocket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+    m_syncSocket->SetRecvCallback (MakeCallback (&staApp::ReceiveSync, this));
+    m_syncSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), SYNC_PORT));
+}
+
+void staApp::SetSuperframe (bool enable, Time minWindow)
+{
+    m_superframe = enable;
+    m_window = m_windowPrev = minWindow.GetTimeStep ();
+    if (m_superframe)
+      {
+        Ptr<Socket> socket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        socket->SetRecvCallback (MakeCallback (&staApp::ReceiveSuperframe, this));
+        socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), SUPERFRAME_PORT));
+        m_sockets.push_back (socket);
+      }
+}
+
+void staApp::SetChurn (Time meanLifetime, Time meanDowntime)
+{
+    m_meanLifetime = meanLifetime;
+    m_meanDowntime = meanDowntime;
+    if (!m_meanLifetime.IsStrictlyPositive ())
+      {
+        return;
+      }
+    m_churn = CreateObject<ExponentialRandomVariable> ();
+    if (!m_slotMap)
+      {
+        // compaction moves us with a slot map
+        Ptr<Socket> socket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        socket->SetRecvCallback (MakeCallback (&staApp::ReceiveSlotMap, this));
+        socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), SLOT_MAP_PORT));
+        m_sockets.push_back (socket);
+      }
+}
+
+void staApp::SetAdaptiveCycle (bool enable)
+{
+    m_adaptive = enable;
+    if (m_adaptive)
+      {
+        Ptr<Socket> socket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        socket->SetRecvCallback (MakeCallback (&staApp::ReceiveCycle, this));
+        socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), CYCLE_PORT));
+        m_sockets.push_back (socket);
+      }
+}
+
+void staApp::SetVarSlots (bool enable)
+{
+    m_varSlots = enable;
+}
+
+void staApp::SetAggregation (Time readingInterval, uint32_t maxBuffered)
+{
+    m_readingInterval = readingInterval;
+    m_maxBuffered = maxBuffered;
+}
+
+void staApp::SetGroupAck (bool enable)
+{
+    m_groupAck = enable;
+    if (m_groupAck)
+      {
+        m_sockets[1]->SetAllowBroadcast (true);
+        m_sockets[1]->SetRecvCallback (MakeCallback (&staApp::DiscardData, this));
+        Ptr<Socket> socket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        socket->SetRecvCallback (MakeCallback (&staApp::ReceiveGroupAck, this));
+        socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), GROUP_ACK_PORT));
+        m_sockets.push_back (socket);
+      }
+}
+
+void staApp::SetAlarms (Time meanInterval, Time frame, uint32_t k, uint32_t slots, Time width)
+{
+    m_alarmInterval = meanInterval;
+    m_alarmFrame = frame.GetTimeStep ();
+    m_alarmK = k;
+    m_alarmSlots = slots;
+    m_alarmWidth = width.GetTimeStep ();
+    if (m_alarmFrame > 0)
+      {
+        m_alarm = CreateObject<ExponentialRandomVariable> ();
+      }
+}
+
+void staApp::SetRetx (uint32_t slots, Time width, bool nack)
+{
+    m_retxSlots = slots;
+    m_retxWidth = width.GetTimeStep ();
+    m_retxNack = nack;
+    if (m_retxSlots == 0)
+      {
+        return;
+      }
+    m_devices[1]->GetRemoteStationManager ()->TraceConnectWithoutContext ("MacTxFinalDataFailed", MakeCallback (&staApp::DataTxFailed, this));
+    if (m_retxNack)
+      {
+        Ptr<Socket> socket = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+        socket->SetRecvCallback (MakeCallback (&staApp::ReceiveNack, this));
+        socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), RETX_PORT));
+        m_sockets.push_back (socket);
+      }
+}
+
 int nDropConn = 0;
 
 static void ApPhyRxDrop(Ptr<const Packet> p)
@@ -300,19 +2083,190 @@ static void ApPhyRxDrop(Ptr<const Packet> p)
   nDropConn++;
 }
 
+static void ApDataRx(Ptr<const Packet> p, const Address &from)
+{
+  uint8_t attempt = 0;
+  p->CopyData (&attempt, 1);
+  if (g_readingSize > 0 && p->GetSize () >= 5)
+    {
+      uint8_t header[5];
+      p->CopyData (header, 5);
+      nReadingsDelivered += (header[3] << 8) | header[4];
+      nBatchFrames++;
+      g_batchAirtime += SlotAirtimeSeconds (g_dataPhy, p->GetSize ());
+    }
+  if (attempt)
+    {
+      nRxAfterRetry++;
+    }
+  else
+    {
+      nRxFirstTry++;
+    }
+}
+
 
 int main (int argc, char *argv[])
 {
     uint32_t nWifi = 100;
     double tslot = 100;
     uint32_t Tcycle = 10;
+    bool staticNodes = false;
+    std::string traceFile = "idtdma-trace.bin";
+    std::string pcapPrefix;
+    std::string pcapMode = "ap";
+    uint32_t pcapEvery = 10;
+    std::string heartbeatFile;
+    bool heartbeatStderr = false;
+    double heartbeatInterval = 10;
+    bool profile = false;
+    std::string profileFile;
+    double idTimeout = 100;
+    double idMaxBackoff = 5000;
+    uint32_t idMaxRetries = 6;
+    bool slotMap = false;
+    double slotMapInterval = 100;
+    double driftPpm = 0;
+    double syncInterval = 1;
+    bool superframe = false;
+    double joinWindowMin = 200;
+    double joinWindowMax = 0;
+    double joinCost = 20;
+    uint32_t retxSlots = 0;
+    double retxSlotWidth = 100;
+    std::string retxMode = "hash";
+    uint32_t nPackets = 2;
+    double churnLifetime = 0;
+    double churnDowntime = 30;
+    double leaseTime = 0;
+    double compactInterval = 60;
+    bool adaptiveCycle = false;
+    double targetUtil = 0.5;
+    double minCycle = 0.1;
+    double maxCycle = 60;
+    double slotGuard = 0;
+    bool varSlots = false;
+    std::string packetSizes = "200";
+    uint32_t readingSize = 0;
+    double readingInterval = 1;
+    uint32_t readingBuffer = 1000;
+    bool groupAck = false;
+    std::string phyMode = "11a:0";
+    double alarmTarget = 0;
+    double alarmInterval = 600;
+    uint32_t alarmSlots = 4;
+
+    CommandLine cmd;
+    cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
+    cmd.AddValue ("Tcycle", "Cycle length in seconds", Tcycle);
+    cmd.AddValue ("staticNodes", "Fixed install: constant STA positions and cached path loss", staticNodes);
+    cmd.AddValue ("traceFile", "Binary lifecycle trace, empty to disable", traceFile);
+    cmd.AddValue ("pcapPrefix", "Merged pcapng capture, one file per channel; empty to disable", pcapPrefix);
+    cmd.AddValue ("pcapMode", "Devices in the capture: all, ap or sample", pcapMode);
+    cmd.AddValue ("pcapEvery", "With pcapMode=sample, capture every n-th station", pcapEvery);
+    cmd.AddValue ("heartbeatFile", "Status file rewritten with progress every heartbeatInterval", heartbeatFile);
+    cmd.AddValue ("heartbeatStderr", "Also print the heartbeat to stderr", heartbeatStderr);
+    cmd.AddValue ("heartbeatInterval", "Wall-clock seconds between heartbeats", heartbeatInterval);
+    cmd.AddValue ("profile", "Report wall time per event type at Simulator::Destroy", profile);
+    cmd.AddValue ("profileFile", "Append the profile report here instead of stderr", profileFile);
+    cmd.AddValue ("idTimeout", "First ID request retransmission timeout in ms, doubled per retry", idTimeout);
+    cmd.AddValue ("idMaxBackoff", "Cap of the ID request backoff in ms", idMaxBackoff);
+    cmd.AddValue ("idMaxRetries", "ID request retransmissions before a station gives up", idMaxRetries);
+    cmd.AddValue ("slotMap", "AP broadcasts run-length encoded slot maps instead of unicast ID replies", slotMap);
+    cmd.AddValue ("slotMapInterval", "Slot map broadcast period in ms", slotMapInterval);
+    cmd.AddValue ("driftPpm", "STA clock drift drawn from +-driftPpm; 0 keeps ideal clocks and relative scheduling", driftPpm);
+    cmd.AddValue ("syncInterval", "AP sync beacon period in s with driftPpm > 0; 0 lets clocks run free", syncInterval);
+    cmd.AddValue ("superframe", "One channel: each cycle opens with a contention window for joins, then TDMA data", superframe);
+    cmd.AddValue ("joinWindowMin", "Shortest contention window in ms", joinWindowMin);
+    cmd.AddValue ("joinWindowMax", "Longest contention window in ms, 0 for half a cycle", joinWindowMax);
+    cmd.AddValue ("joinCost", "Contention window airtime per ID request of the last cycles, in ms", joinCost);
+    cmd.AddValue ("retxSlots", "Retransmission slots at the end of each cycle, 0 to disable", retxSlots);
+    cmd.AddValue ("retxSlotWidth", "Retransmission slot length in ms", retxSlotWidth);
+    cmd.AddValue ("retxMode", "How failed stations pick a retransmission slot: hash or nack", retxMode);
+    cmd.AddValue ("nPackets", "Data packets per station (per life with churn)", nPackets);
+    cmd.AddValue ("churnLifetime", "Mean station lifetime in s before it dies, 0 for a fixed population", churnLifetime);
+    cmd.AddValue ("churnDowntime", "Mean time in s a dead station stays down before rebooting", churnDowntime);
+    cmd.AddValue ("leaseTime", "AP reclaims an ID not heard from for this many s, 0 for 3 cycles", leaseTime);
+    cmd.AddValue ("compactInterval", "Seconds between schedule compactions with churn, 0 to disable", compactInterval);
+    cmd.AddValue ("adaptiveCycle", "AP sizes Tcycle and slot width from assigned IDs and measured airtime", adaptiveCycle);
+    cmd.AddValue ("targetUtil", "Adaptive cycle: share of each slot the data frame should fill", targetUtil);
+    cmd.AddValue ("minCycle", "Adaptive cycle: shortest cycle in s", minCycle);
+    cmd.AddValue ("maxCycle", "Adaptive cycle: longest cycle in s", maxCycle);
+    cmd.AddValue ("slotGuard", "Adaptive cycle and variable slots: least idle time per slot in ms, 0 for two backoff slots of the PHY", slotGuard);
+    cmd.AddValue ("varSlots", "AP sizes each slot to the airtime of the station's payload", varSlots);
+    cmd.AddValue ("packetSizes", "Data payload bytes, comma separated list handed out to the stations in turn", packetSizes);
+    cmd.AddValue ("readingSize", "Aggregate sensor readings of this many bytes per data frame, 0 to send one plain datagram", readingSize);
+    cmd.AddValue ("readingInterval", "Aggregation: seconds between readings of a station", readingInterval);
+    cmd.AddValue ("readingBuffer", "Aggregation: readings a station buffers before dropping new ones", readingBuffer);
+    cmd.AddValue ("phyMode", "Standard and MCS of all devices: 11a:0-7, 11n:0-7, 11ac:0-8 or 11ax:0-11", phyMode);
+    cmd.AddValue ("groupAck", "Data frames without MAC ACK, AP broadcasts a bitmap of heard IDs per cycle", groupAck);
+    cmd.AddValue ("alarmTarget", "Worst-case alarm latency in ms the emergency slots are sized to, 0 for no alarms", alarmTarget);
+    cmd.AddValue ("alarmInterval", "Alarms: mean seconds between alarms of a station", alarmInterval);
+    cmd.AddValue ("alarmSlots", "Alarms: emergency slots per group, contended by hashed station ID", alarmSlots);
+    cmd.Parse (argc,argv);
+    NS_ABORT_MSG_IF (alarmTarget > 0 && (superframe || retxSlots > 0 || adaptiveCycle || varSlots),
+                     "Alarm slots interleave with the fixed data grid: no superframe, retransmission slots, "
+                     "adaptive cycle or variable slots");
+    NS_ABORT_MSG_IF (alarmTarget > 0 && alarmSlots == 0, "alarmSlots must be at least 1");
+    NS_ABORT_MSG_IF (groupAck && (superframe || adaptiveCycle || retxMode == "nack"),
+                     "groupAck needs its own data channel on the fixed grid: no superframe, adaptive cycle or NACK retransmissions");
+    NS_ABORT_MSG_IF (adaptiveCycle && (superframe || retxMode == "nack"),
+                     "adaptiveCycle needs the AP-side grid fixed: no superframe or NACK retransmissions");
+    NS_ABORT_MSG_IF (varSlots && (superframe || retxSlots > 0 || churnLifetime > 0 || adaptiveCycle || slotMap),
+                     "varSlots packs slots from the start of a fixed cycle: no superframe, retransmission slots, churn, "
+                     "adaptive cycle or slot maps");
+    std::vector<uint32_t> sizes;
+    std::istringstream sizeList (packetSizes);
+    std::string size;
+    while (std::getline (sizeList, size, ','))
+      {
+        sizes.push_back (boost::lexical_cast<uint32_t> (size));
+      }
+    NS_ABORT_MSG_IF (sizes.empty (), "packetSizes is empty");
+    NS_ABORT_MSG_IF (readingSize > 0 && *std::min_element (sizes.begin (), sizes.end ()) < 5 + readingSize,
+                     "Every packet size needs room for the 5 byte batch header and one reading");
+    g_readingSize = readingSize;
+    WifiPhyMode mode;
+    NS_ABORT_MSG_IF (!ParseWifiPhyMode (phyMode, mode), "Unknown phyMode " << phyMode);
+    g_dataPhy = mode.slot;
+    if (slotGuard <= 0)
+      {
+        slotGuard = SlotGuardSeconds (g_dataPhy) * 1e3;
+      }
+    if (leaseTime <= 0)
+      {
+        leaseTime = 3.0 * Tcycle;
+      }
 
-//    CommandLine cmd;
-//    cmd.AddValue ("nWifi", "Number of wifi STA devices", nWifi);
-//    cmd.AddValue ("verbose", "Tell echo applications to log if true", verbose);
-//    cmd.AddValue ("tracing", "Enable pcap tracing", tracing);
+    // an alarm raised just after its slot in one group waits one alarm
+    // frame plus at most the whole next group: frames of at most
+    // alarmTarget minus a group, a whole number of them per cycle
+    Time alarmWidth = Seconds (SlotAirtimeSeconds (g_dataPhy, ALARM_BYTES) + slotGuard * 1e-3);
+    Time alarmGroup = TimeStep (alarmWidth.GetTimeStep () * alarmSlots);
+    Time alarmFrame;
+    uint32_t alarmK = 0;
+    if (alarmTarget > 0)
+      {
+        int64_t length = Seconds (Tcycle).GetTimeStep ();
+        int64_t most = (MilliSeconds (alarmTarget) - alarmGroup).GetTimeStep ();
+        NS_ABORT_MSG_IF (most <= 0, "alarmTarget " << alarmTarget << " ms is shorter than one group of "
+                         << alarmSlots << " emergency slots, " << alarmGroup.GetSeconds () * 1e3 << " ms");
+        alarmFrame = TimeStep (length / ((length + most - 1) / most));
+        alarmK = (alarmFrame - alarmGroup).GetTimeStep () / MilliSeconds (tslot).GetTimeStep ();
+        NS_ABORT_MSG_IF (alarmK == 0, "alarmTarget " << alarmTarget << " ms leaves no room for a " << tslot
+                         << " ms data slot between emergency groups, needs at least "
+                         << tslot + 2 * alarmGroup.GetSeconds () * 1e3 << " ms");
+      }
+    NS_ABORT_MSG_IF (retxMode != "hash" && retxMode != "nack", "Unknown retxMode " << retxMode);
+    if (joinWindowMax <= 0)
+      {
+        joinWindowMax = Tcycle * 500.0;
+      }
 
-//    cmd.Parse (argc,argv);
+    if (!traceFile.empty () && !g_trace.Open (traceFile))
+      {
+        NS_FATAL_ERROR ("Cannot open trace file " << traceFile);
+      }
 
     Packet::EnablePrinting ();
 
@@ -333,18 +2287,37 @@ int main (int argc, char *argv[])
     // Assoc Channel
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
     YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
-    phy.SetChannel (channel.Create ());
+    Ptr<YansWifiChannel> assocChannel = channel.Create ();
+    phy.SetChannel (assocChannel);
     phy.Set("ChannelNumber",UintegerValue(0));
 
     // Connection Chann1
     YansWifiChannelHelper channel1 = YansWifiChannelHelper::Default ();
     YansWifiPhyHelper phy1 = YansWifiPhyHelper::Default ();
-    phy1.SetChannel (channel1.Create ());
+    Ptr<YansWifiChannel> dataChannel = channel1.Create ();
+    phy1.SetChannel (dataChannel);
     phy1.Set("ChannelNumber",UintegerValue(1));
 
+    // superframe: data shares the association channel, time split instead
+    if (superframe)
+      {
+        dataChannel = assocChannel;
+        phy1.SetChannel (dataChannel);
+        phy1.Set("ChannelNumber",UintegerValue(0));
+      }
+
+    // nodes never move: compute each rx power once instead of per frame
+    if (staticNodes)
+      {
+        EnablePathLossCache (assocChannel);
+        if (dataChannel != assocChannel)
+          {
+            EnablePathLossCache (dataChannel);
+          }
+      }
+
     WifiHelper wifi;
-    //wifi.SetStandard(WIFI_PHY_STANDARD_80211n_5GHZ);
-    wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager");
+    ApplyWifiPhyMode (wifi, mode, "ns3::ConstantRateWifiManager");
 
     WifiMacHelper mac;
     Ssid ssid = Ssid ("ns-3-ssid");
@@ -353,6 +2326,17 @@ int main (int argc, char *argv[])
     NetDeviceContainer staDevices0;
     staDevices0 = wifi.Install (phy, mac, wifiStaNodes);
 
+    // on a shared channel the data BSS needs its own SSID, or data devices
+    // would associate with the join AP
+    Ssid ssid1 = superframe ? Ssid ("ns-3-ssid-data") : ssid;
+    mac.SetType ("ns3::StaWifiMac","Ssid", SsidValue (ssid1),"ActiveProbing", BooleanValue (false));
+    // group ACK: an infrastructure AP would relay every broadcast data
+    // frame back into the BSS, so the data channel runs ad hoc
+    if (groupAck)
+      {
+        mac.SetType ("ns3::AdhocWifiMac");
+      }
+
     NetDeviceContainer staDevices1;
     staDevices1 = wifi.Install (phy1, mac, wifiStaNodes);
 
@@ -361,7 +2345,13 @@ int main (int argc, char *argv[])
 
     NetDeviceContainer apDevices, apDevices1;
     apDevices = wifi.Install (phy, mac, wifiApNode);
+    mac.SetType ("ns3::ApWifiMac","Ssid", SsidValue (ssid1),"BeaconGeneration", BooleanValue(false),"BeaconInterval", TimeValue(Days(1)));
+    if (groupAck)
+      {
+        mac.SetType ("ns3::AdhocWifiMac");
+      }
     apDevices1 = wifi.Install(phy1,mac,wifiApNode);
+    ConfigureWifiPhyMode (mode);
 
 
     // mobility configuration
@@ -374,8 +2364,15 @@ int main (int argc, char *argv[])
                                  "GridWidth", UintegerValue (20),
                                  "LayoutType", StringValue ("RowFirst"));
 
-    mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
-                             "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+    if (staticNodes)
+      {
+        mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+      }
+    else
+      {
+        mobility.SetMobilityModel ("ns3::RandomWalk2dMobilityModel",
+                                 "Bounds", RectangleValue (Rectangle (-50, 50, -50, 50)));
+      }
     mobility.Install (wifiStaNodes);
 
     mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
@@ -406,17 +2403,39 @@ int main (int argc, char *argv[])
     // app for request id on first channel
 
     Ptr<apApp> apApp1 = CreateObject<apApp>();
+    apApp1->SetSlotMap (slotMap, MilliSeconds (slotMapInterval));
+    if (driftPpm > 0)
+      {
+        apApp1->SetSync (Seconds (syncInterval));
+      }
+    apApp1->SetSuperframe (superframe, Seconds (Tcycle), MilliSeconds (joinWindowMin), MilliSeconds (joinWindowMax), MilliSeconds (joinCost));
+    apApp1->SetRetx (retxSlots, MilliSeconds (retxSlotWidth), retxMode == "nack", Seconds (Tcycle), nWifi);
+    apApp1->SetAdaptiveCycle (adaptiveCycle, Seconds (Tcycle), MilliSeconds (tslot), targetUtil,
+                              Seconds (minCycle), Seconds (maxCycle), MilliSeconds (slotGuard));
+    apApp1->SetVarSlots (varSlots, g_dataPhy, MilliSeconds (slotGuard), Seconds (Tcycle), !groupAck);
+    apApp1->SetGroupAck (groupAck, Seconds (Tcycle));
+    apApp1->SetAlarms (alarmTarget > 0);
+    if (churnLifetime > 0)
+      {
+        apApp1->SetChurn (Seconds (leaseTime), Seconds (compactInterval), Seconds (Tcycle), tslot);
+      }
     wifiApNode.Get(0)->AddApplication(apApp1);
     apApp1->SetStartTime(Seconds(0));
     apApp1->SetStopTime(Seconds(200));
 
     // Packet sink application for data tx on second channel
     uint16_t sinkPort = 9998;
-    Address sinkAddress (InetSocketAddress (apInterface1.GetAddress (0), sinkPort));
+    // group ACK data arrives as subnet broadcast
+    Address sinkAddress (InetSocketAddress (groupAck ? Ipv4Address::GetAny () : apInterface1.GetAddress (0), sinkPort));
     PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", sinkAddress);
     ApplicationContainer sinkApps = packetSinkHelper.Install (wifiApNode.Get (0));
     sinkApps.Start (Seconds (0));
     sinkApps.Stop (Seconds (201));
+    sinkApps.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&ApDataRx));
+    if (churnLifetime > 0 || groupAck)
+      {
+        sinkApps.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&apApp::DataReceived, apApp1));
+      }
     //
 
     Ptr<WifiNetDevice> apwifidev = StaticCast<WifiNetDevice>(apDevices1.Get (0));
@@ -425,23 +2444,186 @@ int main (int argc, char *argv[])
 
     for (uint32_t i=0; i<nWifi; i++)
       {
-        Ptr<staApp> app1 = CreateObject<staApp> (wifiStaNodes.Get (i), apInterface.GetAddress(0), apInterface1.GetAddress(0), i, 200, 2, nWifi);
+        Ptr<staApp> app1 = CreateObject<staApp> (wifiStaNodes.Get (i), apInterface.GetAddress(0), apInterface1.GetAddress(0), i, sizes[i % sizes.size ()], nPackets, nWifi);
         app1->SetCycle(Tcycle);
         wifiStaNodes.Get (i)->AddApplication (app1);
         app1->SetSlotTime(tslot);
+        app1->SetIdRetry (MilliSeconds (idTimeout), MilliSeconds (idMaxBackoff), idMaxRetries);
+        app1->SetSlotMap (slotMap);
+        if (driftPpm > 0)
+          {
+            app1->SetClock (driftPpm);
+          }
+        app1->SetSuperframe (superframe, MilliSeconds (joinWindowMin));
+        app1->SetRetx (retxSlots, MilliSeconds (retxSlotWidth), retxMode == "nack");
+        app1->SetChurn (Seconds (churnLifetime), Seconds (churnDowntime));
+        app1->SetAdaptiveCycle (adaptiveCycle);
+        app1->SetVarSlots (varSlots);
+        app1->SetAggregation (Seconds (readingInterval), readingBuffer);
+        app1->SetGroupAck (groupAck);
+        app1->SetAlarms (Seconds (alarmInterval), alarmFrame, alarmK, alarmSlots, alarmWidth);
         app1->SetStartTime (MilliSeconds (1000));
         app1->SetStopTime (Seconds (200));
       }
 
+    // one pcapng per channel instead of one pcap per device
+    Ptr<PcapngCapture> assocCapture = Create<PcapngCapture> ();
+    Ptr<PcapngCapture> dataCapture = Create<PcapngCapture> ();
+    if (!pcapPrefix.empty ())
+      {
+        NS_ABORT_MSG_IF (!assocCapture->Open (pcapPrefix + "-assoc.pcapng"), "Cannot open capture " << pcapPrefix);
+        NS_ABORT_MSG_IF (!dataCapture->Open (pcapPrefix + "-data.pcapng"), "Cannot open capture " << pcapPrefix);
+        assocCapture->AddDevices (apDevices, staDevices0, pcapMode, pcapEvery);
+        dataCapture->AddDevices (apDevices1, staDevices1, pcapMode, pcapEvery);
+      }
+
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
     Simulator::Stop (Seconds (201.0));
 
+    std::ostringstream label;
+    label << "nWifi=" << nWifi << " Tc=" << Tcycle;
+    if (!heartbeatFile.empty () || heartbeatStderr)
+      {
+        EnableHeartbeat (label.str (), Seconds (201.0), heartbeatFile, heartbeatStderr, heartbeatInterval);
+      }
+    if (profile)
+      {
+        EnableEventProfiler (label.str (), profileFile);
+      }
+
     Simulator::Run ();
     Simulator::Destroy ();
+    g_trace.Close ();
+    assocCapture->Close ();
+    dataCapture->Close ();
 
     uint64_t totalPacketsThrough = DynamicCast<PacketSink> (sinkApps.Get(0))->GetTotalRx ();
     std::cout<< totalPacketsThrough<<std::endl;
     std::cout<< nDropConn<<std::endl;
+
+    // how many slots of the largest payload one cycle holds on this PHY
+    uint32_t largestPayload = *std::max_element (sizes.begin (), sizes.end ());
+    double phySlot = SlotAirtimeSeconds (g_dataPhy, largestPayload, !groupAck) + slotGuard * 1e-3;
+    std::cout<< phyMode<<": "<<largestPayload<<" byte slot "<<phySlot * 1e6<<" us with "<<slotGuard * 1e3
+             <<" us guard, ceiling "<<(uint32_t) (Tcycle / phySlot)<<" stations per cycle"<<std::endl;
+    std::cout<< nIdAssigned<<"/"<<nWifi<<" stations got an ID, "<<nIdRetries<<" request retries, "
+             <<nIdGiveUps<<" gave up, "<<nIdRepeated<<" repeated requests at the AP"<<std::endl;
+    std::cout<< nIdFrames<<(slotMap ? " slot map frames, " : " ID reply frames, ")<<nIdFrameBytes<<" payload bytes"<<std::endl;
+    if (!g_joinSeconds.empty ())
+      {
+        std::sort (g_joinSeconds.begin (), g_joinSeconds.end ());
+        std::cout<< "join latency p50 "<<g_joinSeconds[g_joinSeconds.size () / 2]
+                 <<" s, p99 "<<g_joinSeconds[(g_joinSeconds.size () * 99) / 100]
+                 <<" s, max "<<g_joinSeconds.back ()<<" s"<<std::endl;
+      }
+    if (varSlots && nVarSlots > 0)
+      {
+        // uniform slots would all be as wide as the widest payload needs
+        std::cout<< "variable slots: "<<nVarSlots<<" slots fill "<<g_varAirtime * 1e3<<" ms of "<<Tcycle * 1e3
+                 <<" ms, uniform slots would fill "<<nVarSlots * g_varMaxSlot * 1e3<<" ms; "
+                 <<nVarOverflow<<" slots past the cycle end"<<std::endl;
+      }
+    if (groupAck)
+      {
+        // stations per cycle if slots were sized to the largest payload
+        uint32_t largest = *std::max_element (sizes.begin (), sizes.end ());
+        double withAck = SlotAirtimeSeconds (g_dataPhy, largest) + slotGuard * 1e-3;
+        double dataOnly = SlotAirtimeSeconds (g_dataPhy, largest, false) + slotGuard * 1e-3;
+        std::cout<< "group ACK: "<<nGroupAckFrames<<" bitmap frames, "<<nGroupAckBytes<<" bytes; "<<nGroupAcked
+                 <<" frames acknowledged, "<<nGroupLost<<" missing, "<<nRetxSent<<" resent"<<std::endl;
+        std::cout<< "slot for "<<largest<<" bytes: "<<dataOnly * 1e6<<" us without ACK, "<<withAck * 1e6
+                 <<" us with, stations per cycle "<<(uint32_t) (Tcycle / dataOnly)<<" vs "
+                 <<(uint32_t) (Tcycle / withAck)<<std::endl;
+      }
+    if (alarmTarget > 0)
+      {
+        uint32_t frames = Tcycle / alarmFrame.GetSeconds () + 0.5;
+        std::cout<< "alarm slots: "<<alarmSlots<<" x "<<alarmWidth.GetSeconds () * 1e6<<" us after every "<<alarmK
+                 <<" data slots, frame "<<alarmFrame.GetSeconds () * 1e3<<" ms, worst case "
+                 <<(alarmFrame + alarmGroup).GetSeconds () * 1e3<<" ms for a "<<alarmTarget<<" ms target; "
+                 <<frames * alarmK<<" data slots per cycle instead of "<<(uint32_t) (Tcycle * 1e3 / tslot)<<std::endl;
+        std::cout<< "alarms: "<<nAlarms<<" raised, "<<g_alarmLatency.size ()<<" delivered in "<<nAlarmFrames
+                 <<" frames, "<<nAlarmsLost<<" lost with their station";
+        if (!g_alarmLatency.empty ())
+          {
+            std::sort (g_alarmLatency.begin (), g_alarmLatency.end ());
+            uint32_t late = g_alarmLatency.end ()
+                            - std::upper_bound (g_alarmLatency.begin (), g_alarmLatency.end (), alarmTarget * 1e-3);
+            std::cout<< "; latency p50 "<<g_alarmLatency[g_alarmLatency.size () / 2] * 1e3
+                     <<" ms, p99 "<<g_alarmLatency[(g_alarmLatency.size () * 99) / 100] * 1e3
+                     <<" ms, max "<<g_alarmLatency.back () * 1e3<<" ms, "<<late<<" over target";
+          }
+        std::cout<<std::endl;
+      }
+    if (readingSize > 0 && nBatchFrames > 0)
+      {
+        // share of the slot airtime (access, data, ACK) spent on reading bytes
+        double rate = g_dataPhy.dataBitsPerSymbol / g_dataPhy.symbolS;
+        double useful = (double) nReadingsDelivered * readingSize * 8 / rate;
+        double single = readingSize * 8 / rate / SlotAirtimeSeconds (g_dataPhy, 5 + readingSize);
+        std::cout<< "aggregation: "<<nReadings<<" readings, "<<nReadingsDelivered<<" delivered in "<<nBatchFrames
+                 <<" frames, "<<nReadingsDropped<<" dropped at full buffers"<<std::endl;
+        std::cout<< "useful bytes per slot "<<(double) nReadingsDelivered * readingSize / nBatchFrames
+                 <<", slot airtime efficiency "<<100 * useful / g_batchAirtime<<" % (one reading per frame: "
+                 <<100 * single<<" %)"<<std::endl;
+      }
+    if (adaptiveCycle && nCycleAnnouncements > 0)
+      {
+        std::cout<< "adaptive cycle: "<<nCycleChanges<<" schedule changes over "<<nCycleAnnouncements
+                 <<" cycles, mean cycle "<<g_cycleSum / nCycleAnnouncements<<" s, data frame airtime "
+                 <<g_airtime * 1e6<<" us"<<std::endl;
+      }
+    if (churnLifetime > 0)
+      {
+        std::cout<< "churn: "<<nLeaves<<" leaves, "<<nRejoins<<" rejoins, "<<nReclaimed<<" IDs reclaimed on lease expiry"<<std::endl;
+        std::cout<< nCompactions<<" compactions moved "<<nIdMoved<<" stations with "<<nCompactionBytes<<" map bytes";
+        if (nEffCycleSamples > 0)
+          {
+            std::cout<< ", effective cycle mean "<<g_effCycleSum / nEffCycleSamples<<" s of "<<Tcycle<<" s";
+          }
+        std::cout<<std::endl;
+        if (!g_rejoinToData.empty ())
+          {
+            std::sort (g_rejoinToData.begin (), g_rejoinToData.end ());
+            std::cout<< "rejoin to first data p50 "<<g_rejoinToData[g_rejoinToData.size () / 2]
+                     <<" s, p99 "<<g_rejoinToData[(g_rejoinToData.size () * 99) / 100]
+                     <<" s, max "<<g_rejoinToData.back ()<<" s"<<std::endl;
+          }
+      }
+    if (retxSlots > 0)
+      {
+        std::cout<< "delivered first try "<<nRxFirstTry<<", after retry "<<nRxAfterRetry<<"; "
+                 <<nDataFailed<<" data frames failed, "<<nRetxSent<<" retransmitted";
+        if (retxMode == "nack")
+          {
+            std::cout<< ", "<<nNacked<<" slots NACKed, "<<nRetxUnclaimed<<" left without a slot";
+          }
+        std::cout<<std::endl;
+      }
+    if (superframe && nSuperframes > 0)
+      {
+        double meanWindow = g_joinWindowSum / nSuperframes;
+        std::cout<< "superframe: "<<nSuperframes<<" cycles, join window mean "<<meanWindow * 1e3
+                 <<" ms, max "<<g_joinWindowMax * 1e3<<" ms, data share "
+                 <<100 * (1 - meanWindow / Tcycle)<<" % of the channel"<<std::endl;
+      }
+    if (driftPpm > 0)
+      {
+        // neighbouring slots can be off in opposite directions, so the
+        // guard has to absorb twice the worst single clock error
+        std::cout<< "clock drift up to "<<g_maxDriftPpm<<" ppm, "<<nSyncBeacons<<" sync beacons, sync error max "
+                 <<g_maxSyncError * 1e6<<" us"<<std::endl;
+        std::cout<< "slot start error max "<<g_maxSlotError * 1e6<<" us over "<<nSlotSamples
+                 <<" tx, guard needed >= "<<2 * g_maxSlotError * 1e6<<" us"<<std::endl;
+        std::cout<< "minimum guard time per resync interval:"<<std::endl;
+        double intervals[] = {0.1, 0.5, 1, 2, 5, 10, 30, 60};
+        for (uint32_t i = 0; i < sizeof (intervals) / sizeof (intervals[0]); i++)
+          {
+            double guard = 2 * (g_maxDriftPpm * 1e-6 * intervals[i] + g_maxSyncError);
+            std::cout<< "  "<<intervals[i]<<" s: "<<guard * 1e6<<" us"
+                     <<(intervals[i] == syncInterval ? "  <- this run" : "")<<std::endl;
+          }
+      }
     return 0;
 }
@@ -0,0 +1,245 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/applications-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * Send time of a data packet, added by the STA and read back at the sink.
+ */
+class SendTimeTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  void SetSent (Time sent);
+  Time GetSent (void) const;
+
+private:
+  int64_t m_sentTs;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SendTimeTag);
+
+TypeId
+SendTimeTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SendTimeTag")
+    .SetParent<Tag> ()
+    .AddConstructor<SendTimeTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+SendTimeTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+SendTimeTag::GetSerializedSize (void) const
+{
+  return 8;
+}
+
+void
+SendTimeTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (m_sentTs);
+}
+
+void
+SendTimeTag::Deserialize (TagBuffer i)
+{
+  m_sentTs = i.ReadU64 ();
+}
+
+void
+SendTimeTag::Print (std::ostream &os) const
+{
+  os << "sent=" << TimeStep (m_sentTs);
+}
+
+void
+SendTimeTag::SetSent (Time sent)
+{
+  m_sentTs = sent.GetTimeStep ();
+}
+
+Time
+SendTimeTag::GetSent (void) const
+{
+  return TimeStep (m_sentTs);
+}
+
+/*
+ * End-to-end latency of the data packets of one cell: Stamp() tags each
+ * packet the STAs send, the PacketSink Rx trace turns every tagged packet
+ * it receives into a sample. AttachDrops() on the AP data PHY counts the
+ * packets this probe stamped that the PHY dropped and the sink never got,
+ * so co-channel cells with probes of their own don't mix. A packet counts
+ * once however many of its MAC attempts were lost, and not at all once a
+ * retry got through, so GetDropped() + GetDelivered() <= GetSent().
+ * Reset() between cells.
+ */
+class LatencyProbe
+{
+public:
+  LatencyProbe ();
+
+  void Reset (void);
+  void Stamp (Ptr<Packet> packet);
+  void Attach (Ptr<Application> sink);
+  void AttachDrops (Ptr<Object> phy);
+
+  uint64_t GetSent (void) const;
+  uint64_t GetDelivered (void) const;
+  uint64_t GetDropped (void) const;
+  // nearest-rank percentile, q in [0, 1]; 0 when nothing was delivered
+  double GetPercentileMs (double q);
+
+private:
+  static void SinkRx (LatencyProbe *probe, Ptr<const Packet> packet, const Address &from);
+  static void PhyRxDrop (LatencyProbe *probe, Ptr<const Packet> packet);
+
+  uint64_t m_sent;
+  std::vector<int64_t> m_samples;
+  bool m_sorted;
+  std::set<uint64_t> m_dropped; // packet UIDs, shared by the MAC retries
+  std::set<uint64_t> m_delivered;
+  std::set<uint64_t> m_stamped;
+};
+
+LatencyProbe::LatencyProbe ()
+  : m_sent (0),
+    m_sorted (true)
+{
+}
+
+void
+LatencyProbe::Reset (void)
+{
+  m_sent = 0;
+  m_samples.clear ();
+  m_sorted = true;
+  m_dropped.clear ();
+  m_delivered.clear ();
+  m_stamped.clear ();
+}
+
+void
+LatencyProbe::Stamp (Ptr<Packet> packet)
+{
+  SendTimeTag tag;
+  tag.SetSent (Simulator::Now ());
+  packet->AddPacketTag (tag);
+  m_sent++;
+  m_stamped.insert (packet->GetUid ());
+}
+
+void
+LatencyProbe::Attach (Ptr<Application> sink)
+{
+  sink->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&LatencyProbe::SinkRx, this));
+}
+
+void
+LatencyProbe::AttachDrops (Ptr<Object> phy)
+{
+  phy->TraceConnectWithoutContext ("PhyRxDrop", MakeBoundCallback (&LatencyProbe::PhyRxDrop, this));
+}
+
+void
+LatencyProbe::PhyRxDrop (LatencyProbe *probe, Ptr<const Packet> packet)
+{
+  // management frames, ACKs, ARP and other cells' data were not stamped
+  // here; a retry the sink already has the packet of (its ACK was lost)
+  // is no loss
+  if (probe->m_stamped.find (packet->GetUid ()) != probe->m_stamped.end ()
+      && probe->m_delivered.find (packet->GetUid ()) == probe->m_delivered.end ())
+    {
+      probe->m_dropped.insert (packet->GetUid ());
+    }
+}
+
+void
+LatencyProbe::SinkRx (LatencyProbe *probe, Ptr<const Packet> packet, const Address &from)
+{
+  SendTimeTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      probe->m_samples.push_back ((Simulator::Now () - tag.GetSent ()).GetTimeStep ());
+      probe->m_sorted = false;
+      probe->m_delivered.insert (packet->GetUid ());
+      probe->m_dropped.erase (packet->GetUid ());
+    }
+}
+
+uint64_t
+LatencyProbe::GetSent (void) const
+{
+  return m_sent;
+}
+
+uint64_t
+LatencyProbe::GetDelivered (void) const
+{
+  return m_samples.size ();
+}
+
+uint64_t
+LatencyProbe::GetDropped (void) const
+{
+  return m_dropped.size ();
+}
+
+double
+LatencyProbe::GetPercentileMs (double q)
+{
+  if (m_samples.empty ())
+    {
+      return 0;
+    }
+  if (!m_sorted)
+    {
+      std::sort (m_samples.begin (), m_samples.end ());
+      m_sorted = true;
+    }
+  uint32_t rank = std::min<uint32_t> (m_samples.size () - 1, std::max (0.0, std::ceil (q * m_samples.size ()) - 1));
+  return TimeStep (m_samples[rank]).GetSeconds () * 1e3;
+}
+
+} // namespace ns3
+
+#endif /* LATENCY_PROBE_H */
@@ -0,0 +1,300 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PCAPNG_CAPTURE_H
+#define PCAPNG_CAPTURE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/wifi-module.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/*
+ * One pcapng file for any number of wifi devices, instead of the one pcap
+ * file (and one buffered writer) per device that WifiPhyHelper::EnablePcap
+ * opens. Every device becomes an interface of the section; frames are
+ * Enhanced Packet Blocks tagged with the interface id and the direction,
+ * with nanosecond timestamps. Blocks are appended to a large in-memory
+ * buffer and written with one fwrite when it fills; a block is never split
+ * across two writes.
+ *
+ * Frames are taken from PhyTxBegin / PhyRxEnd and carry the 802.11 MAC
+ * header and FCS (LINKTYPE_IEEE802_11, no radiotap).
+ */
+class PcapngCapture : public SimpleRefCount<PcapngCapture>
+{
+public:
+  PcapngCapture ();
+  ~PcapngCapture ();
+
+  bool Open (std::string path, uint32_t bufferBytes = 4 << 20);
+  void Close (void);
+
+  // returns the pcapng interface id of the device
+  uint32_t AddDevice (Ptr<NetDevice> device, std::string name);
+
+  // "all": every device, "ap": AP side only, "sample": AP plus every
+  // every-th station
+  void AddDevices (NetDeviceContainer ap, NetDeviceContainer sta, std::string mode, uint32_t every);
+
+  uint64_t GetFrames (void) const;
+
+private:
+  static void SnifferTx (PcapngCapture *capture, uint32_t interface, Ptr<const Packet> packet);
+  static void SnifferRx (PcapngCapture *capture, uint32_t interface, Ptr<const Packet> packet);
+
+  void WritePacket (uint32_t interface, Ptr<const Packet> packet, bool outbound);
+  void Put32 (uint32_t v);
+  void Put16 (uint16_t v);
+  void PutBytes (const void *data, uint32_t size);
+  void Pad (void);
+  void Reserve (uint32_t size);
+  void Drain (void);
+
+  FILE *m_file;
+  std::vector<uint8_t> m_buffer;
+  uint32_t m_used;
+  uint32_t m_nInterfaces;
+  uint64_t m_frames;
+};
+
+PcapngCapture::PcapngCapture ()
+  : m_file (0),
+    m_used (0),
+    m_nInterfaces (0),
+    m_frames (0)
+{
+}
+
+PcapngCapture::~PcapngCapture ()
+{
+  Close ();
+}
+
+bool
+PcapngCapture::Open (std::string path, uint32_t bufferBytes)
+{
+  Close ();
+  m_file = std::fopen (path.c_str (), "wb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  // we do our own buffering
+  std::setvbuf (m_file, 0, _IONBF, 0);
+  m_buffer.resize (bufferBytes);
+  m_used = 0;
+  m_nInterfaces = 0;
+  m_frames = 0;
+
+  // Section Header Block
+  Reserve (28);
+  Put32 (0x0A0D0D0A);
+  Put32 (28);
+  Put32 (0x1A2B3C4D);
+  Put16 (1);
+  Put16 (0);
+  Put32 (0xFFFFFFFF);           // section length unknown
+  Put32 (0xFFFFFFFF);
+  Put32 (28);
+  return true;
+}
+
+void
+PcapngCapture::Close (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  Drain ();
+  std::fclose (m_file);
+  m_file = 0;
+}
+
+uint64_t
+PcapngCapture::GetFrames (void) const
+{
+  return m_frames;
+}
+
+uint32_t
+PcapngCapture::AddDevice (Ptr<NetDevice> device, std::string name)
+{
+  NS_ASSERT (m_file != 0);
+  uint32_t nameLen = name.size ();
+  uint32_t namePadded = (nameLen + 3) & ~3u;
+  // header 16, if_name 4+name, if_tsresol 4+4, if_fcslen 4+4, end 4, trailer 4
+  uint32_t total = 16 + 4 + namePadded + 8 + 8 + 4 + 4;
+
+  // Interface Description Block
+  Reserve (total);
+  Put32 (1);
+  Put32 (total);
+  Put16 (105);                  // LINKTYPE_IEEE802_11
+  Put16 (0);
+  Put32 (65535);
+  Put16 (2);                    // if_name
+  Put16 (nameLen);
+  PutBytes (name.data (), nameLen);
+  Pad ();
+  Put16 (9);                    // if_tsresol: 10^-9
+  Put16 (1);
+  uint8_t tsresol[4] = {9, 0, 0, 0};
+  PutBytes (tsresol, 4);
+  Put16 (13);                   // if_fcslen
+  Put16 (1);
+  uint8_t fcslen[4] = {4, 0, 0, 0};
+  PutBytes (fcslen, 4);
+  Put32 (0);                    // opt_endofopt
+  Put32 (total);
+
+  uint32_t interface = m_nInterfaces++;
+  Ptr<WifiPhy> phy = StaticCast<WifiNetDevice> (device)->GetPhy ();
+  phy->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&PcapngCapture::SnifferTx, this, interface));
+  phy->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&PcapngCapture::SnifferRx, this, interface));
+  return interface;
+}
+
+void
+PcapngCapture::AddDevices (NetDeviceContainer ap, NetDeviceContainer sta, std::string mode, uint32_t every)
+{
+  NS_ABORT_MSG_IF (mode != "all" && mode != "ap" && mode != "sample", "Unknown capture mode " << mode);
+  for (uint32_t i = 0; i < ap.GetN (); i++)
+    {
+      std::ostringstream name;
+      name << "ap" << i << "-node" << ap.Get (i)->GetNode ()->GetId ();
+      AddDevice (ap.Get (i), name.str ());
+    }
+  if (mode == "ap")
+    {
+      return;
+    }
+  uint32_t step = (mode == "sample" && every > 0) ? every : 1;
+  for (uint32_t i = 0; i < sta.GetN (); i += step)
+    {
+      std::ostringstream name;
+      name << "sta" << i << "-node" << sta.Get (i)->GetNode ()->GetId ();
+      AddDevice (sta.Get (i), name.str ());
+    }
+}
+
+void
+PcapngCapture::SnifferTx (PcapngCapture *capture, uint32_t interface, Ptr<const Packet> packet)
+{
+  capture->WritePacket (interface, packet, true);
+}
+
+void
+PcapngCapture::SnifferRx (PcapngCapture *capture, uint32_t interface, Ptr<const Packet> packet)
+{
+  capture->WritePacket (interface, packet, false);
+}
+
+void
+PcapngCapture::WritePacket (uint32_t interface, Ptr<const Packet> packet, bool outbound)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  uint32_t size = packet->GetSize ();
+  uint32_t captured = std::min<uint32_t> (size, 65535);
+  uint32_t padded = (captured + 3) & ~3u;
+  // header 28, data, epb_flags 4+4, end 4, trailer 4
+  uint32_t total = 28 + padded + 8 + 4 + 4;
+  Reserve (total);
+
+  uint64_t ts = Simulator::Now ().GetNanoSeconds ();
+  Put32 (6);                    // Enhanced Packet Block
+  Put32 (total);
+  Put32 (interface);
+  Put32 (ts >> 32);
+  Put32 (ts & 0xFFFFFFFF);
+  Put32 (captured);
+  Put32 (size);
+  packet->CopyData (&m_buffer[m_used], captured);
+  m_used += captured;
+  Pad ();
+  Put16 (2);                    // epb_flags: direction
+  Put16 (4);
+  Put32 (outbound ? 2 : 1);
+  Put32 (0);
+  Put32 (total);
+  m_frames++;
+}
+
+void
+PcapngCapture::Reserve (uint32_t size)
+{
+  if (m_used + size > m_buffer.size ())
+    {
+      Drain ();
+    }
+  if (size > m_buffer.size ())
+    {
+      m_buffer.resize (size);
+    }
+}
+
+void
+PcapngCapture::Drain (void)
+{
+  if (m_used > 0)
+    {
+      std::fwrite (&m_buffer[0], 1, m_used, m_file);
+      m_used = 0;
+    }
+}
+
+void
+PcapngCapture::Put32 (uint32_t v)
+{
+  PutBytes (&v, 4);
+}
+
+void
+PcapngCapture::Put16 (uint16_t v)
+{
+  PutBytes (&v, 2);
+}
+
+void
+PcapngCapture::PutBytes (const void *data, uint32_t size)
+{
+  Reserve (size);
+  std::memcpy (&m_buffer[m_used], data, size);
+  m_used += size;
+}
+
+void
+PcapngCapture::Pad (void)
+{
+  static const uint8_t zeros[4] = {0, 0, 0, 0};
+  PutBytes (zeros, (4 - (m_used & 3)) & 3);
+}
+
+} // namespace ns3
+
+#endif /* PCAPNG_CAPTURE_H */
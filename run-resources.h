@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RUN_RESOURCES_H
+#define RUN_RESOURCES_H
+
+// Cost of one sweep cell: wall and CPU time split into setup (building
+// nodes, devices, apps) and run (Simulator::Run + Destroy), peak RSS and
+// the number of dispatched events.
+
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+#include <sys/resource.h>
+
+struct RunResources
+{
+  double setupWallS;
+  double runWallS;
+  double setupCpuS;
+  double runCpuS;
+  double userCpuS;
+  double sysCpuS;
+  uint64_t peakRssKb;
+  uint64_t events;
+};
+
+class ResourceMeter
+{
+public:
+  void Start (void);
+  void SetupDone (void);
+  RunResources Stop (uint64_t events);
+
+  static void WriteCsvHeader (std::ostream &os);
+  static void WriteCsv (std::ostream &os, uint32_t nWifi, uint32_t Tcycle, uint32_t seed, std::string phyMode,
+                        const RunResources &r);
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  static void Cpu (double &user, double &sys);
+  static uint64_t PeakRssKb (void);
+
+  Clock::time_point m_start;
+  Clock::time_point m_setup;
+  double m_user0, m_sys0;
+  double m_userSetup, m_sysSetup;
+};
+
+inline void
+ResourceMeter::Cpu (double &user, double &sys)
+{
+  struct rusage ru;
+  getrusage (RUSAGE_SELF, &ru);
+  user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6;
+  sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+// VmHWM of this process. ru_maxrss never goes down, so Start() resets the
+// kernel's high-water mark (Linux clear_refs) to get a per-cell peak; where
+// that is not available the process-wide maximum is reported instead.
+inline uint64_t
+ResourceMeter::PeakRssKb (void)
+{
+  std::ifstream status ("/proc/self/status");
+  std::string key;
+  while (status >> key)
+    {
+      if (key == "VmHWM:")
+        {
+          uint64_t kb = 0;
+          status >> kb;
+          return kb;
+        }
+      status.ignore (4096, '\n');
+    }
+  struct rusage ru;
+  getrusage (RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+inline void
+ResourceMeter::Start (void)
+{
+  std::ofstream clear ("/proc/self/clear_refs");
+  if (clear)
+    {
+      clear << "5" << std::endl;
+    }
+  m_start = m_setup = Clock::now ();
+  Cpu (m_user0, m_sys0);
+  m_userSetup = m_user0;
+  m_sysSetup = m_sys0;
+}
+
+inline void
+ResourceMeter::SetupDone (void)
+{
+  m_setup = Clock::now ();
+  Cpu (m_userSetup, m_sysSetup);
+}
+
+inline RunResources
+ResourceMeter::Stop (uint64_t events)
+{
+  Clock::time_point end = Clock::now ();
+  double user, sys;
+  Cpu (user, sys);
+
+  RunResources r;
+  r.setupWallS = std::chrono::duration<double> (m_setup - m_start).count ();
+  r.runWallS = std::chrono::duration<double> (end - m_setup).count ();
+  r.setupCpuS = (m_userSetup - m_user0) + (m_sysSetup - m_sys0);
+  r.runCpuS = (user - m_userSetup) + (sys - m_sysSetup);
+  r.userCpuS = user - m_user0;
+  r.sysCpuS = sys - m_sys0;
+  r.peakRssKb = PeakRssKb ();
+  r.events = events;
+  return r;
+}
+
+inline void
+ResourceMeter::WriteCsvHeader (std::ostream &os)
+{
+  os << "nWifi,Tcycle,seed,phy_mode,setup_wall_s,run_wall_s,setup_cpu_s,run_cpu_s,user_cpu_s,sys_cpu_s,peak_rss_kb,events"
+     << std::endl;
+}
+
+inline void
+ResourceMeter::WriteCsv (std::ostream &os, uint32_t nWifi, uint32_t Tcycle, uint32_t seed, std::string phyMode,
+                         const RunResources &r)
+{
+  os << nWifi << "," << Tcycle << "," << seed << "," << phyMode << ","
+     << r.setupWallS << "," << r.runWallS << ","
+     << r.setupCpuS << "," << r.runCpuS << ","
+     << r.userCpuS << "," << r.sysCpuS << ","
+     << r.peakRssKb << "," << r.events << std::endl;
+}
+
+#endif /* RUN_RESOURCES_H */
@@ -0,0 +1,237 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SIMULATION_HEARTBEAT_H
+#define SIMULATION_HEARTBEAT_H
+
+#include "ns3/core-module.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace ns3 {
+
+/*
+ * Progress report of a running simulation: simulated time, wall time,
+ * dispatched (not cancelled) events, event rate and estimated completion. It is driven
+ * from the scheduler rather than by a simulation event, so it keeps
+ * coming at a fixed wall-clock pace however slow simulated time advances,
+ * and a run stuck inside one event shows up as a stale status file.
+ *
+ * The status file is rewritten through a temporary file and rename(), so
+ * readers never see a half-written report.
+ */
+class Heartbeat
+{
+public:
+  static void Start (std::string label, Time stopTime, std::string path, bool toStderr, double intervalSeconds);
+  static void Tick (const Scheduler::Event &ev);
+  static void Finish (void);
+
+  static uint64_t GetEvents (void);
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  static void Beat (Clock::time_point now, int64_t simTs, const char *state);
+
+  static bool s_enabled;
+  static std::string s_label;
+  static std::string s_path;
+  static bool s_stderr;
+  static double s_interval;
+  static int64_t s_stopTs;
+  static uint64_t s_events;
+  static int64_t s_simTs;
+  static Clock::time_point s_start;
+  static Clock::time_point s_last;
+  static uint64_t s_lastEvents;
+  static int64_t s_lastSimTs;
+};
+
+bool Heartbeat::s_enabled = false;
+std::string Heartbeat::s_label;
+std::string Heartbeat::s_path;
+bool Heartbeat::s_stderr = false;
+double Heartbeat::s_interval = 10;
+int64_t Heartbeat::s_stopTs = 0;
+uint64_t Heartbeat::s_events = 0;
+int64_t Heartbeat::s_simTs = 0;
+Heartbeat::Clock::time_point Heartbeat::s_start;
+Heartbeat::Clock::time_point Heartbeat::s_last;
+uint64_t Heartbeat::s_lastEvents = 0;
+int64_t Heartbeat::s_lastSimTs = 0;
+
+void
+Heartbeat::Start (std::string label, Time stopTime, std::string path, bool toStderr, double intervalSeconds)
+{
+  s_enabled = true;
+  s_label = label;
+  s_path = path;
+  s_stderr = toStderr;
+  s_interval = intervalSeconds;
+  s_stopTs = stopTime.GetTimeStep ();
+  s_events = 0;
+  s_simTs = 0;
+  s_start = s_last = Clock::now ();
+  s_lastEvents = 0;
+  s_lastSimTs = 0;
+  Beat (s_start, 0, "running");
+}
+
+void
+Heartbeat::Tick (const Scheduler::Event &ev)
+{
+  if (!s_enabled)
+    {
+      return;
+    }
+  s_simTs = ev.key.m_ts;
+  // a cancelled event is popped but never runs; the profiler leaves it
+  // out too, so both report the same event count
+  if (ev.impl->IsCancelled ())
+    {
+      return;
+    }
+  // reading the clock costs more than the bookkeeping, so only look every
+  // few thousand events
+  if ((++s_events & 4095) != 0)
+    {
+      return;
+    }
+  Clock::time_point now = Clock::now ();
+  if (std::chrono::duration<double> (now - s_last).count () >= s_interval)
+    {
+      Beat (now, s_simTs, "running");
+    }
+}
+
+void
+Heartbeat::Finish (void)
+{
+  if (!s_enabled)
+    {
+      return;
+    }
+  Beat (Clock::now (), s_simTs, "finished");
+  s_enabled = false;
+}
+
+uint64_t
+Heartbeat::GetEvents (void)
+{
+  return s_events;
+}
+
+void
+Heartbeat::Beat (Clock::time_point now, int64_t simTs, const char *state)
+{
+  double wall = std::chrono::duration<double> (now - s_start).count ();
+  double window = std::chrono::duration<double> (now - s_last).count ();
+  double sim = TimeStep (simTs).GetSeconds ();
+  double stop = TimeStep (s_stopTs).GetSeconds ();
+  double rate = window > 0 ? (s_events - s_lastEvents) / window : 0;
+  double simRate = window > 0 ? (TimeStep (simTs).GetSeconds () - TimeStep (s_lastSimTs).GetSeconds ()) / window : 0;
+  double eta = simRate > 0 ? (stop - sim) / simRate : -1;
+
+  std::ostringstream report;
+  report << "label " << s_label << "\n"
+         << "state " << state << "\n"
+         << "sim_time_s " << sim << "\n"
+         << "stop_time_s " << stop << "\n"
+         << "wall_time_s " << wall << "\n"
+         << "events " << s_events << "\n"
+         << "events_per_s " << rate << "\n"
+         << "events_per_s_avg " << (wall > 0 ? s_events / wall : 0) << "\n"
+         << "sim_s_per_wall_s " << simRate << "\n"
+         << "eta_s " << eta << "\n";
+
+  if (!s_path.empty ())
+    {
+      std::string tmp = s_path + ".tmp";
+      std::ofstream ofs (tmp.c_str ());
+      ofs << report.str ();
+      ofs.close ();
+      if (ofs)
+        {
+          std::rename (tmp.c_str (), s_path.c_str ());
+        }
+    }
+  if (s_stderr)
+    {
+      std::cerr << "[" << s_label << "] " << state << " sim " << sim << "/" << stop << " s, wall "
+                << wall << " s, " << rate << " ev/s, eta " << eta << " s" << std::endl;
+    }
+
+  s_last = now;
+  s_lastEvents = s_events;
+  s_lastSimTs = simTs;
+}
+
+/*
+ * MapScheduler that feeds every dispatched event to the heartbeat.
+ */
+class HeartbeatMapScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  virtual Scheduler::Event RemoveNext (void);
+};
+
+NS_OBJECT_ENSURE_REGISTERED (HeartbeatMapScheduler);
+
+TypeId
+HeartbeatMapScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::HeartbeatMapScheduler")
+    .SetParent<MapScheduler> ()
+    .AddConstructor<HeartbeatMapScheduler> ()
+  ;
+  return tid;
+}
+
+Scheduler::Event
+HeartbeatMapScheduler::RemoveNext (void)
+{
+  Scheduler::Event ev = MapScheduler::RemoveNext ();
+  Heartbeat::Tick (ev);
+  return ev;
+}
+
+/*
+ * Report progress of the current simulation every intervalSeconds of wall
+ * time. Like the event profiler this replaces the scheduler, so it has to
+ * be enabled again after every Simulator::Destroy, and before
+ * EnableEventProfiler when both are used.
+ */
+inline void
+EnableHeartbeat (std::string label, Time stopTime, std::string path, bool toStderr, double intervalSeconds = 10)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::HeartbeatMapScheduler");
+  Simulator::SetScheduler (factory);
+  Heartbeat::Start (label, stopTime, path, toStderr, intervalSeconds);
+  Simulator::ScheduleDestroy (&Heartbeat::Finish);
+}
+
+} // namespace ns3
+
+#endif /* SIMULATION_HEARTBEAT_H */
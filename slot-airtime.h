@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SLOT_AIRTIME_H
+#define SLOT_AIRTIME_H
+
+// Airtime of one TDMA data slot: the channel access wait, the UDP data
+// frame and its ACK. A datagram of n bytes is an MPDU of n + 64 bytes
+// (UDP 8, IPv4 20, LLC/SNAP 8, MAC header 24, FCS 4) on 802.11a; the HT
+// and later standards send QoS data, 2 bytes more header, after AIFS[BE]
+// instead of DIFS. The ACK is 14 bytes in a legacy PPDU at the highest
+// mandatory 5 GHz rate (6, 12, 24 Mbit/s) not above the data rate, so
+// it keeps 4 us symbols whatever the data symbols are.
+//
+// PPDU: preamble, then ceil((16 service + 8 * bytes + 6 tail) / bits per
+// symbol) symbols. All modes are 20 MHz, one spatial stream, 800 ns GI;
+// single MPDUs, no A-MPDU.
+
+#include <cmath>
+#include <stdint.h>
+
+static const uint32_t SLOT_UDP_OVERHEAD = 64;
+static const uint32_t SLOT_ACK_BYTES = 14;
+
+struct SlotPhy
+{
+  double preambleS;         // everything ahead of the data symbols
+  double symbolS;
+  uint32_t dataBitsPerSymbol;
+  uint32_t ackBitsPerSymbol;
+  double ackPreambleS;
+  double ackSymbolS;        // legacy OFDM, also after HE data
+  double sifsS;
+  double difsS;             // AIFS[BE] for QoS data
+  double slotS;             // backoff slot, the carrier sense granularity
+  uint32_t mpduOverhead;    // bytes around the UDP payload
+};
+
+inline uint32_t
+SlotControlBitsPerSymbol (double rateMbps)
+{
+  double control = rateMbps >= 24 ? 24 : rateMbps >= 12 ? 12 : 6;
+  return (uint32_t) (control * 4);
+}
+
+// 802.11a, the ns-3 default standard. Rate in Mbit/s.
+inline SlotPhy
+SlotPhyOfdm (double rateMbps)
+{
+  SlotPhy phy;
+  phy.preambleS = 20e-6;
+  phy.symbolS = 4e-6;
+  phy.dataBitsPerSymbol = (uint32_t) std::floor (rateMbps * 4 + 0.5);
+  phy.ackBitsPerSymbol = SlotControlBitsPerSymbol (rateMbps);
+  phy.ackPreambleS = 20e-6;
+  phy.ackSymbolS = 4e-6;
+  phy.sifsS = 16e-6;
+  phy.slotS = 9e-6;
+  phy.difsS = phy.sifsS + 2 * phy.slotS;
+  phy.mpduOverhead = SLOT_UDP_OVERHEAD;
+  return phy;
+}
+
+// QoS data after AIFS[BE] = SIFS + 3 slots; bits per symbol and the
+// preamble ahead of the data field
+inline SlotPhy
+SlotPhyQos (uint32_t bitsPerSymbol, double symbolS, double preambleS)
+{
+  SlotPhy phy = SlotPhyOfdm (6);
+  phy.preambleS = preambleS;
+  phy.symbolS = symbolS;
+  phy.dataBitsPerSymbol = bitsPerSymbol;
+  phy.ackBitsPerSymbol = SlotControlBitsPerSymbol (bitsPerSymbol / symbolS * 1e-6);
+  phy.difsS = phy.sifsS + 3 * phy.slotS;
+  phy.mpduOverhead = SLOT_UDP_OVERHEAD + 2;
+  return phy;
+}
+
+// HT mixed format: legacy 20 us, HT-SIG 8, HT-STF 4, one HT-LTF 4
+inline bool
+SlotPhyHt (uint32_t mcs, SlotPhy &phy)
+{
+  static const uint32_t bits[] = {26, 52, 78, 104, 156, 208, 234, 260};
+  if (mcs >= sizeof (bits) / sizeof (bits[0]))
+    {
+      return false;
+    }
+  phy = SlotPhyQos (bits[mcs], 4e-6, 36e-6);
+  return true;
+}
+
+// VHT: legacy 20 us, VHT-SIG-A 8, VHT-STF 4, one VHT-LTF 4, VHT-SIG-B 4;
+// MCS 9 is not defined for one stream at 20 MHz
+inline bool
+SlotPhyVht (uint32_t mcs, SlotPhy &phy)
+{
+  static const uint32_t bits[] = {26, 52, 78, 104, 156, 208, 234, 260, 312};
+  if (mcs >= sizeof (bits) / sizeof (bits[0]))
+    {
+      return false;
+    }
+  phy = SlotPhyQos (bits[mcs], 4e-6, 40e-6);
+  return true;
+}
+
+// HE SU: legacy 20 us, RL-SIG 4, HE-SIG-A 8, HE-STF 4, one HE-LTF 8;
+// 12.8 us symbols plus the guard interval
+inline bool
+SlotPhyHe (uint32_t mcs, SlotPhy &phy)
+{
+  static const uint32_t bits[] = {117, 234, 351, 468, 702, 936, 1053, 1170, 1404, 1560, 1755, 1950};
+  if (mcs >= sizeof (bits) / sizeof (bits[0]))
+    {
+      return false;
+    }
+  phy = SlotPhyQos (bits[mcs], 13.6e-6, 44e-6);
+  return true;
+}
+
+// Least idle time between two slots: the next station must not see the
+// tail of the previous frame when it senses the channel, so one backoff
+// slot for detection plus one for rx/tx turnaround and propagation.
+inline double
+SlotGuardSeconds (const SlotPhy &phy)
+{
+  return 2 * phy.slotS;
+}
+
+inline double
+SlotPpduSeconds (double preambleS, double symbolS, uint32_t bitsPerSymbol, uint32_t bytes)
+{
+  uint32_t symbols = (16 + 8 * bytes + 6 + bitsPerSymbol - 1) / bitsPerSymbol;
+  return preambleS + symbols * symbolS;
+}
+
+inline double
+SlotDataSeconds (const SlotPhy &phy, uint32_t udpPayload)
+{
+  return SlotPpduSeconds (phy.preambleS, phy.symbolS, phy.dataBitsPerSymbol, udpPayload + phy.mpduOverhead);
+}
+
+// DIFS + data, plus SIFS + ACK unless the frame goes out unacknowledged
+inline double
+SlotAirtimeSeconds (const SlotPhy &phy, uint32_t udpPayload, bool ack = true)
+{
+  double t = phy.difsS + SlotDataSeconds (phy, udpPayload);
+  if (ack)
+    {
+      t += phy.sifsS + SlotPpduSeconds (phy.ackPreambleS, phy.ackSymbolS, phy.ackBitsPerSymbol, SLOT_ACK_BYTES);
+    }
+  return t;
+}
+
+#endif /* SLOT_AIRTIME_H */
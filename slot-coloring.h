@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SLOT_COLORING_H
+#define SLOT_COLORING_H
+
+// Spatial slot reuse: stations that cannot spoil each other's frame at the
+// receiver serving them may share a TDMA slot. The conflict graph is built
+// from predicted (or measured) rx power of every station at every receiver,
+// and a DSATUR coloring turns it into slots: color = slot.
+//
+// j spoils i when i is decodable at all and j arrives at i's receiver less
+// than captureDb below i. With a single receiver every pair of decodable
+// stations conflicts; the reuse comes from stations served by different
+// receivers, or too weak at each other's receiver to matter.
+//
+// Pairs that pass can still fail together, so a station only joins a color
+// when every decodable member keeps the data and ACK SINR with the whole
+// class sending at once (SlotClassFits).
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+// rxDbm[i][r]: station i at receiver r; serving[i]: the receiver i sends to.
+inline std::vector< std::vector<uint32_t> >
+BuildConflictGraph (const std::vector< std::vector<double> > &rxDbm, const std::vector<uint32_t> &serving,
+                    double sensitivityDbm, double captureDb)
+{
+  uint32_t n = rxDbm.size ();
+  std::vector< std::vector<uint32_t> > adj (n);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      for (uint32_t j = i + 1; j < n; j++)
+        {
+          double pi = rxDbm[i][serving[i]], pj = rxDbm[j][serving[j]];
+          bool spoilsI = pi >= sensitivityDbm && rxDbm[j][serving[i]] > pi - captureDb;
+          bool spoilsJ = pj >= sensitivityDbm && rxDbm[i][serving[j]] > pj - captureDb;
+          if (spoilsI || spoilsJ)
+            {
+              adj[i].push_back (j);
+              adj[j].push_back (i);
+            }
+        }
+    }
+  return adj;
+}
+
+// Stations above sensitivity at their serving receiver; the ones a slot
+// can help at all, so reuse factors are taken over these.
+inline uint32_t
+CountDecodable (const std::vector< std::vector<double> > &rxDbm, const std::vector<uint32_t> &serving,
+                double sensitivityDbm)
+{
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < rxDbm.size (); i++)
+    {
+      n += rxDbm[i][serving[i]] >= sensitivityDbm;
+    }
+  return n;
+}
+
+// What one receiver needs, from the data rate: powers in dBm, SINR in dB
+struct SlotSinrModel
+{
+  double noiseDbm;          // thermal noise over the channel plus noise figure
+  double sensitivityDbm;    // least data rx power the rate decodes
+  double dataSinrDb;        // data frame at the serving receiver
+  double ackSinrDb;         // ACK back at the station, legacy control rate
+};
+
+inline double
+SlotDbmToMw (double dbm)
+{
+  return std::pow (10.0, dbm / 10);
+}
+
+// Whether the decodable members of one slot all still decode with the
+// whole slot sending at once. Data at a member's receiver sees the other
+// stations plus the ACKs of the other receivers the slot serves, since a
+// slot is sized to its longest frame and ACKs overlap shorter data. The
+// ACK at the member sees the other receivers' ACKs. apRxDbm[q][r]:
+// receiver q at receiver r; receiver to station is taken as reciprocal.
+inline bool
+SlotClassFits (const std::vector< std::vector<double> > &rxDbm, const std::vector< std::vector<double> > &apRxDbm,
+               const std::vector<uint32_t> &serving, const SlotSinrModel &model, const std::vector<uint32_t> &members)
+{
+  std::set<uint32_t> acking;
+  for (uint32_t k = 0; k < members.size (); k++)
+    {
+      if (rxDbm[members[k]][serving[members[k]]] >= model.sensitivityDbm)
+        {
+          acking.insert (serving[members[k]]);
+        }
+    }
+  for (uint32_t k = 0; k < members.size (); k++)
+    {
+      uint32_t m = members[k], r = serving[m];
+      double p = rxDbm[m][r];
+      if (p < model.sensitivityDbm)
+        {
+          continue;
+        }
+      double data = SlotDbmToMw (model.noiseDbm), ack = data;
+      for (uint32_t o = 0; o < members.size (); o++)
+        {
+          if (o != k)
+            {
+              data += SlotDbmToMw (rxDbm[members[o]][r]);
+            }
+        }
+      for (std::set<uint32_t>::const_iterator q = acking.begin (); q != acking.end (); q++)
+        {
+          if (*q != r)
+            {
+              data += SlotDbmToMw (apRxDbm[*q][r]);
+              ack += SlotDbmToMw (rxDbm[m][*q]);
+            }
+        }
+      if (p - 10 * std::log10 (data) < model.dataSinrDb || p - 10 * std::log10 (ack) < model.ackSinrDb)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+// DSATUR over the pairwise conflict graph (captureDb = the data SINR):
+// always color the vertex with the most distinct neighbor colors (ties:
+// most neighbors) with the lowest color its neighbors leave free and
+// whose class still fits with it. Returns the color per vertex; nColors
+// gets the number used.
+inline std::vector<uint32_t>
+ColorSlotsBySinr (const std::vector< std::vector<double> > &rxDbm, const std::vector< std::vector<double> > &apRxDbm,
+                  const std::vector<uint32_t> &serving, const SlotSinrModel &model, uint32_t &nColors)
+{
+  std::vector< std::vector<uint32_t> > adj = BuildConflictGraph (rxDbm, serving, model.sensitivityDbm, model.dataSinrDb);
+  uint32_t n = adj.size ();
+  const uint32_t NONE = 0xFFFFFFFF;
+  std::vector<uint32_t> color (n, NONE);
+  std::vector< std::set<uint32_t> > seen (n);
+  std::vector< std::vector<uint32_t> > classes;
+  for (uint32_t done = 0; done < n; done++)
+    {
+      uint32_t best = NONE;
+      for (uint32_t v = 0; v < n; v++)
+        {
+          if (color[v] != NONE)
+            {
+              continue;
+            }
+          if (best == NONE || seen[v].size () > seen[best].size ()
+              || (seen[v].size () == seen[best].size () && adj[v].size () > adj[best].size ()))
+            {
+              best = v;
+            }
+        }
+      uint32_t c = 0;
+      for (; c < classes.size (); c++)
+        {
+          if (seen[best].count (c))
+            {
+              continue;
+            }
+          classes[c].push_back (best);
+          if (SlotClassFits (rxDbm, apRxDbm, serving, model, classes[c]))
+            {
+              break;
+            }
+          classes[c].pop_back ();
+        }
+      if (c == classes.size ())
+        {
+          classes.push_back (std::vector<uint32_t> (1, best));
+        }
+      color[best] = c;
+      for (uint32_t k = 0; k < adj[best].size (); k++)
+        {
+          seen[adj[best][k]].insert (c);
+        }
+    }
+  nColors = classes.size ();
+  return color;
+}
+
+#endif /* SLOT_COLORING_H */
@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+// Broadcast slot map: the MAC -> slot assignments the AP made since its
+// last map, run-length encoded. A run says "count stations starting at MAC
+// m get the slots starting at s", so stations that joined in MAC order
+// (consecutive MACs, consecutive IDs) cost 10 bytes per run rather than
+// per station; unrelated MACs degrade to one run each.
+//
+//   frame: 'S' 'M' version nRuns(u16), nRuns x {mac(6) slot(u16) count(u16)}
+//
+// All fields big-endian. MACs are handled as 48-bit integers.
+
+#include <algorithm>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+static const uint8_t SLOT_MAP_VERSION = 1;
+static const uint32_t SLOT_MAP_HEADER = 5;
+static const uint32_t SLOT_MAP_RUN = 10;
+
+struct SlotMapRun
+{
+  uint64_t mac;
+  uint16_t slot;
+  uint16_t count;
+};
+
+// entries: (mac, slot), any order. Returns frames of at most maxBytes.
+inline std::vector< std::vector<uint8_t> >
+SlotMapEncode (std::vector< std::pair<uint64_t, uint16_t> > entries, uint32_t maxBytes)
+{
+  std::sort (entries.begin (), entries.end ());
+  std::vector<SlotMapRun> runs;
+  for (uint32_t i = 0; i < entries.size (); i++)
+    {
+      if (!runs.empty ())
+        {
+          SlotMapRun &last = runs.back ();
+          if (entries[i].first == last.mac + last.count
+              && entries[i].second == last.slot + last.count
+              && last.count < 0xFFFF)
+            {
+              last.count++;
+              continue;
+            }
+        }
+      SlotMapRun run = {entries[i].first, entries[i].second, 1};
+      runs.push_back (run);
+    }
+
+  uint32_t perFrame = std::max<uint32_t> (1, (maxBytes - SLOT_MAP_HEADER) / SLOT_MAP_RUN);
+  std::vector< std::vector<uint8_t> > frames;
+  for (uint32_t first = 0; first < runs.size (); first += perFrame)
+    {
+      uint32_t n = std::min<uint32_t> (perFrame, runs.size () - first);
+      std::vector<uint8_t> frame;
+      frame.push_back ('S');
+      frame.push_back ('M');
+      frame.push_back (SLOT_MAP_VERSION);
+      frame.push_back (n >> 8);
+      frame.push_back (n & 0xFF);
+      for (uint32_t r = first; r < first + n; r++)
+        {
+          for (int b = 5; b >= 0; b--)
+            {
+              frame.push_back ((runs[r].mac >> (8 * b)) & 0xFF);
+            }
+          frame.push_back (runs[r].slot >> 8);
+          frame.push_back (runs[r].slot & 0xFF);
+          frame.push_back (runs[r].count >> 8);
+          frame.push_back (runs[r].count & 0xFF);
+        }
+      frames.push_back (frame);
+    }
+  return frames;
+}
+
+// Finds mac in a received frame; false if it is not in there or the frame
+// is not a slot map.
+inline bool
+SlotMapLookup (const uint8_t *frame, uint32_t size, uint64_t mac, uint16_t &slot)
+{
+  if (size < SLOT_MAP_HEADER || frame[0] != 'S' || frame[1] != 'M' || frame[2] != SLOT_MAP_VERSION)
+    {
+      return false;
+    }
+  uint32_t n = (frame[3] << 8) | frame[4];
+  if (size < SLOT_MAP_HEADER + n * SLOT_MAP_RUN)
+    {
+      return false;
+    }
+  const uint8_t *p = frame + SLOT_MAP_HEADER;
+  for (uint32_t r = 0; r < n; r++, p += SLOT_MAP_RUN)
+    {
+      uint64_t first = 0;
+      for (int b = 0; b < 6; b++)
+        {
+          first = (first << 8) | p[b];
+        }
+      uint16_t firstSlot = (p[6] << 8) | p[7];
+      uint16_t count = (p[8] << 8) | p[9];
+      if (mac >= first && mac < first + count)
+        {
+          slot = firstSlot + (mac - first);
+          return true;
+        }
+    }
+  return false;
+}
+
+#endif /* SLOT_MAP_H */
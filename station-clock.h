@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef STATION_CLOCK_H
+#define STATION_CLOCK_H
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+/*
+ * Local oscillator of a station. It runs drift (e.g. +20e-6) faster than
+ * simulator time and is stepped to the AP's time whenever a sync beacon
+ * arrives:
+ *
+ *   local(t) = t + error0 + drift * (t - syncAt)
+ *
+ * where error0 is the error left right after the last sync (the beacon's
+ * delivery delay). Slot times are kept in local time and converted back
+ * to a simulator delay with GetDelay.
+ */
+class StationClock : public SimpleRefCount<StationClock>
+{
+public:
+  StationClock (double driftPpm);
+
+  Time GetLocal (Time now) const;
+  // simulator time until the local clock shows localTarget
+  Time GetDelay (Time localTarget, Time now) const;
+  // the AP said it was reference when its beacon left; we got it at now
+  void Sync (Time now, Time reference);
+
+  double GetDriftPpm (void) const;
+
+private:
+  double m_drift;
+  int64_t m_error0;
+  int64_t m_syncAt;
+};
+
+StationClock::StationClock (double driftPpm)
+  : m_drift (driftPpm * 1e-6),
+    m_error0 (0),
+    m_syncAt (0)
+{
+}
+
+Time
+StationClock::GetLocal (Time now) const
+{
+  int64_t t = now.GetTimeStep ();
+  return TimeStep (t + m_error0 + std::llround (m_drift * (t - m_syncAt)));
+}
+
+Time
+StationClock::GetDelay (Time localTarget, Time now) const
+{
+  double ahead = (localTarget - GetLocal (now)).GetTimeStep () / (1 + m_drift);
+  return TimeStep (std::max<int64_t> (0, std::llround (ahead)));
+}
+
+void
+StationClock::Sync (Time now, Time reference)
+{
+  m_syncAt = now.GetTimeStep ();
+  m_error0 = (reference - now).GetTimeStep ();
+}
+
+double
+StationClock::GetDriftPpm (void) const
+{
+  return m_drift * 1e6;
+}
+
+} // namespace ns3
+
+#endif /* STATION_CLOCK_H */
@@ -0,0 +1,276 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SWEEP_CACHE_H
+#define SWEEP_CACHE_H
+
+#include "ns3/core-module.h"
+#include "ns3/hash.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <elf.h>
+#include <link.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace ns3 {
+
+/*
+ * On-disk cache of sweep cell results. A cell is described by a config
+ * string, one "name value" line per parameter that can change its outcome;
+ * the entry is named after the hash of that string and the build ID of the
+ * program, so rebuilding the binary or the ns-3 libraries never returns
+ * stale numbers. The config is stored with the results and compared on
+ * lookup, a hash collision is a miss.
+ *
+ *   dir/<16 hex digits>.cell:
+ *     <config lines>
+ *     --
+ *     <result name> <value>
+ */
+class SweepCache
+{
+public:
+  SweepCache ();
+
+  // empty dir disables the cache; refresh ignores existing entries and
+  // overwrites them with the new results
+  void Open (std::string dir, bool refresh);
+  bool IsOpen (void) const;
+
+  bool Lookup (const std::string &config, std::map<std::string, double> &results);
+  void Store (const std::string &config, const std::map<std::string, double> &results);
+
+  uint32_t GetHits (void) const;
+  uint32_t GetMisses (void) const;
+
+  // bump when the set or meaning of the stored results changes; 3: cells
+  // seeded from their config (SeedSweepCell), independent of sweep order;
+  // 4: drops counts data packets once, phy_drops every dropped frame;
+  // 5: legacy ACK symbols after HE data (Ts0 and slot ceiling of 11ax);
+  // 6: drops leaves out packets a retry delivered
+  static const uint32_t VERSION = 6;
+
+  static std::string BuildId (void);
+
+private:
+  std::string Path (const std::string &config) const;
+  static int AddObject (struct dl_phdr_info *info, size_t size, void *data);
+
+  std::string m_dir;
+  std::string m_buildId;
+  bool m_refresh;
+  uint32_t m_hits;
+  uint32_t m_misses;
+};
+
+SweepCache::SweepCache ()
+  : m_refresh (false),
+    m_hits (0),
+    m_misses (0)
+{
+}
+
+void
+SweepCache::Open (std::string dir, bool refresh)
+{
+  m_dir = dir;
+  m_refresh = refresh;
+  if (m_dir.empty ())
+    {
+      return;
+    }
+  if (mkdir (m_dir.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      NS_FATAL_ERROR ("Cannot create cache directory " << m_dir << ": " << std::strerror (errno));
+    }
+  m_buildId = BuildId ();
+}
+
+bool
+SweepCache::IsOpen (void) const
+{
+  return !m_dir.empty ();
+}
+
+uint32_t
+SweepCache::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint32_t
+SweepCache::GetMisses (void) const
+{
+  return m_misses;
+}
+
+std::string
+SweepCache::Path (const std::string &config) const
+{
+  std::ostringstream key;
+  key << "cacheVersion " << VERSION << "\nbuild " << m_buildId << "\n" << config;
+  std::ostringstream path;
+  path << m_dir << "/" << std::hex << std::setw (16) << std::setfill ('0') << Hash64 (key.str ()) << ".cell";
+  return path.str ();
+}
+
+bool
+SweepCache::Lookup (const std::string &config, std::map<std::string, double> &results)
+{
+  if (!IsOpen () || m_refresh)
+    {
+      m_misses++;
+      return false;
+    }
+  std::ifstream ifs (Path (config).c_str ());
+  std::string stored;
+  std::string line;
+  while (std::getline (ifs, line) && line != "--")
+    {
+      stored += line + "\n";
+    }
+  if (!ifs || stored != config)
+    {
+      m_misses++;
+      return false;
+    }
+  results.clear ();
+  std::string name;
+  double value;
+  while (ifs >> name >> value)
+    {
+      results[name] = value;
+    }
+  m_hits++;
+  return true;
+}
+
+void
+SweepCache::Store (const std::string &config, const std::map<std::string, double> &results)
+{
+  if (!IsOpen ())
+    {
+      return;
+    }
+  // write and rename, so a sweep killed halfway never leaves a truncated
+  // entry that would be read back as a hit
+  std::string path = Path (config);
+  std::string tmp = path + ".tmp";
+  std::ofstream ofs (tmp.c_str ());
+  ofs << config << "--\n" << std::setprecision (std::numeric_limits<double>::max_digits10);
+  for (std::map<std::string, double>::const_iterator it = results.begin (); it != results.end (); ++it)
+    {
+      ofs << it->first << " " << it->second << "\n";
+    }
+  ofs.close ();
+  if (ofs)
+    {
+      std::rename (tmp.c_str (), path.c_str ());
+    }
+}
+
+// One line per loaded object that can change the results: the program
+// itself and the ns-3 libraries. The GNU build-id note identifies a build
+// exactly; objects linked without one fall back to size and mtime.
+int
+SweepCache::AddObject (struct dl_phdr_info *info, size_t size, void *data)
+{
+  std::ostringstream &os = *static_cast<std::ostringstream *> (data);
+  std::string name = info->dlpi_name;
+  if (name.empty ())
+    {
+      name = "/proc/self/exe";
+    }
+  else if (name.find ("ns3") == std::string::npos)
+    {
+      return 0;
+    }
+
+  for (int i = 0; i < info->dlpi_phnum; i++)
+    {
+      const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+      if (phdr.p_type != PT_NOTE)
+        {
+          continue;
+        }
+      const char *p = reinterpret_cast<const char *> (info->dlpi_addr + phdr.p_vaddr);
+      const char *end = p + phdr.p_memsz;
+      while (p + sizeof (ElfW(Nhdr)) <= end)
+        {
+          const ElfW(Nhdr) *note = reinterpret_cast<const ElfW(Nhdr) *> (p);
+          const char *noteName = p + sizeof (ElfW(Nhdr));
+          const uint8_t *desc = reinterpret_cast<const uint8_t *> (noteName + ((note->n_namesz + 3) & ~3u));
+          if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && std::memcmp (noteName, "GNU", 4) == 0)
+            {
+              os << name << " ";
+              for (uint32_t j = 0; j < note->n_descsz; j++)
+                {
+                  os << std::hex << std::setw (2) << std::setfill ('0') << (uint32_t)desc[j];
+                }
+              os << std::dec << "\n";
+              return 0;
+            }
+          p = reinterpret_cast<const char *> (desc) + ((note->n_descsz + 3) & ~3u);
+        }
+    }
+
+  struct stat st;
+  if (stat (name.c_str (), &st) == 0)
+    {
+      os << name << " " << st.st_size << " " << st.st_mtime << "\n";
+    }
+  return 0;
+}
+
+std::string
+SweepCache::BuildId (void)
+{
+  std::ostringstream objects;
+  dl_iterate_phdr (&SweepCache::AddObject, &objects);
+  std::ostringstream id;
+  id << std::hex << std::setw (16) << std::setfill ('0') << Hash64 (objects.str ());
+  return id.str ();
+}
+
+/*
+ * Make a cell's random draws a function of its config alone, so the config
+ * really identifies the cached result. ns-3 numbers automatic streams from
+ * a counter that keeps running across Simulator::Destroy: without this a
+ * cell draws differently depending on how many cells were built before it,
+ * and a cache hit (which builds nothing) shifts every later cell. The run
+ * number comes from the config; the caller still has to put every random
+ * object of the cell on an explicit stream with AssignStreams (channels,
+ * devices, mobility, internet stack) before Simulator::Run.
+ */
+inline void
+SeedSweepCell (const std::string &config)
+{
+  RngSeedManager::SetRun (Hash64 (config));
+}
+
+} // namespace ns3
+
+#endif /* SWEEP_CACHE_H */
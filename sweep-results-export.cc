@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Exports sweep results files written by idtdma-tests / idtdma-tests2 as
+// one CSV table.
+//
+//   sweep-results-export sweep-results.bin [more.bin ...] > results.csv
+//   sweep-results-export --selfTest     checks the writer and loader
+
+#include "sweep-results.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static SweepRecord
+TestRecord (std::string scenario, uint32_t nWifi)
+{
+  SweepRecord r;
+  SweepRecordInit (r, scenario);
+  r.nWifi = nWifi;
+  return r;
+}
+
+static bool
+CheckRecords (std::string path, std::string what, const char *scenarios, const uint32_t *nWifi, uint32_t n)
+{
+  std::vector<SweepRecord> records;
+  bool ok = SweepResultsLoad (path, records) && records.size () == n;
+  for (uint32_t i = 0; ok && i < n; i++)
+    {
+      ok = records[i].scenario[0] == scenarios[i] && records[i].nWifi == nWifi[i];
+    }
+  std::cerr << (ok ? "pass: " : "FAIL: ") << what << std::endl;
+  return ok;
+}
+
+// A crash mid-group leaves a partial group at the end of the file; the
+// next sweep must append after the last complete one, not after the cut.
+// Version 1 files must still load, and a sweep appending to one must
+// move it aside rather than fail.
+static int
+SelfTest (void)
+{
+  char path[] = "/tmp/sweep-results-testXXXXXX";
+  int fd = mkstemp (path);
+  if (fd < 0)
+    {
+      return 1;
+    }
+  close (fd);
+  std::remove (path);
+
+  bool ok = true;
+  SweepResultsWriter writer;
+  ok &= writer.Open (path, 1);
+  writer.Add (TestRecord ("a", 1));
+  writer.Add (TestRecord ("a", 2));
+  writer.Close ();
+  const uint32_t two[] = {1, 2};
+  ok &= CheckRecords (path, "two groups", "aa", two, 2);
+
+  FILE *f = std::fopen (path, "rb");
+  std::fseek (f, 0, SEEK_END);
+  long size = std::ftell (f);
+  std::fclose (f);
+  ok &= truncate (path, size - 10) == 0;
+  const uint32_t cut[] = {1};
+  ok &= CheckRecords (path, "cut group ignored", "a", cut, 1);
+
+  ok &= writer.Open (path, 1);
+  writer.Add (TestRecord ("b", 3));
+  writer.Close ();
+  const uint32_t appended[] = {1, 3};
+  ok &= CheckRecords (path, "append after a cut group", "ab", appended, 2);
+
+  // a version 1 file: the columns up to wall_s, one group of "c 4"
+  std::remove (path);
+  f = std::fopen (path, "wb");
+  SweepResultsFileHeader header;
+  std::memcpy (header.magic, "SWRC", 4);
+  header.version = 1;
+  header.nColumns = SWEEP_RESULTS_V1_COLUMNS;
+  header.reserved = 0;
+  std::fwrite (&header, sizeof (header), 1, f);
+  for (uint32_t c = 0; c < SWEEP_RESULTS_V1_COLUMNS; c++)
+    {
+      SweepResultsColumnHeader column;
+      std::memset (&column, 0, sizeof (column));
+      std::strncpy (column.name, g_sweepColumns[c].name, sizeof (column.name) - 1);
+      column.type = g_sweepColumns[c].type;
+      std::fwrite (&column, sizeof (column), 1, f);
+    }
+  SweepResultsGroupHeader group;
+  std::memcpy (group.magic, "RGRP", 4);
+  group.nRows = 1;
+  std::fwrite (&group, sizeof (group), 1, f);
+  SweepRecord old = TestRecord ("c", 4);
+  for (uint32_t c = 0; c < SWEEP_RESULTS_V1_COLUMNS; c++)
+    {
+      std::fwrite (reinterpret_cast<const char *> (&old) + g_sweepColumns[c].offset, 1,
+                   SweepColumnWidth (g_sweepColumns[c].type), f);
+    }
+  std::fclose (f);
+  const uint32_t v1[] = {4};
+  ok &= CheckRecords (path, "version 1 loads", "c", v1, 1);
+  std::vector<SweepRecord> records;
+  bool defaults = SweepResultsLoad (path, records) && records.size () == 1
+    && std::string (records[0].phyMode) == "11a:0" && records[0].slotCeiling == 0;
+  std::cerr << (defaults ? "pass: " : "FAIL: ") << "version 1 defaults" << std::endl;
+  ok &= defaults;
+
+  std::string moved = std::string (path) + ".v1";
+  ok &= writer.Open (path, 1);
+  writer.Add (TestRecord ("d", 5));
+  writer.Close ();
+  const uint32_t fresh[] = {5};
+  ok &= CheckRecords (path, "append to version 1 starts a new file", "d", fresh, 1);
+  ok &= CheckRecords (moved, "version 1 file moved aside", "c", v1, 1);
+
+  std::remove (path);
+  std::remove (moved.c_str ());
+  return ok ? 0 : 1;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cerr << "usage: sweep-results-export <results file>... | --selfTest" << std::endl;
+      return 2;
+    }
+  if (std::string (argv[1]) == "--selfTest")
+    {
+      return SelfTest ();
+    }
+
+  std::vector<SweepRecord> records;
+  for (int i = 1; i < argc; i++)
+    {
+      if (!SweepResultsLoad (argv[i], records))
+        {
+          std::cerr << argv[i] << " is not a sweep results file" << std::endl;
+          return 1;
+        }
+    }
+
+  SweepResultsWriteCsvHeader (std::cout);
+  for (uint32_t i = 0; i < records.size (); i++)
+    {
+      SweepResultsWriteCsv (std::cout, records[i]);
+    }
+  return 0;
+}
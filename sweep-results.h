@@ -0,0 +1,488 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SWEEP_RESULTS_H
+#define SWEEP_RESULTS_H
+
+// Results of the sweeps, one record per (scenario, nWifi, Tcycle, seed).
+// The file is append-only and columnar: a header naming the columns, then
+// row groups that store each column contiguously. Every sweep appends its
+// own groups to the same file, so a study of many runs is one file that
+// loads with a single read. sweep-results-export turns it into CSV. No
+// ns-3 dependency so the exporter builds on its own.
+//
+//   header:    "SWRC" version nColumns 0, nColumns x {name[24] type 0}
+//   row group: "RGRP" nRows, then nRows values of each column in order
+//
+// Version 1 files have the columns up to wall_s. They still load, as
+// phy_mode "11a:0" and slot_ceiling 0; a sweep appending to one moves it
+// aside to <path>.v1 and starts a new file.
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct SweepRecord
+{
+  char scenario[16];
+  uint32_t nWifi;
+  uint32_t Tcycle;
+  uint32_t seed;
+  uint32_t packetSize;
+  uint64_t sent;            // data packets the STAs sent
+  uint64_t delivered;       // data packets the AP sink received
+  uint64_t rxBytes;
+  uint64_t drops;           // data packets the AP data PHY dropped and the sink never got
+  double deliveryRatio;
+  double dropRate;
+  double latencyP50Ms;      // send to sink receive, delivered packets only
+  double latencyP90Ms;
+  double latencyP99Ms;
+  double latencyMaxMs;
+  double wallS;             // setup plus run, of the run that produced it
+  char phyMode[16];         // "standard:mcs", see wifi-phy-mode.h
+  uint32_t slotCeiling;     // data slots per Tcycle the PHY allows
+};
+
+enum SweepColumnType
+{
+  SWEEP_COLUMN_U32 = 1,
+  SWEEP_COLUMN_U64,
+  SWEEP_COLUMN_F64,
+  SWEEP_COLUMN_STR16,
+};
+
+struct SweepColumn
+{
+  const char *name;
+  uint32_t type;
+  size_t offset;
+};
+
+static const SweepColumn g_sweepColumns[] = {
+  {"scenario", SWEEP_COLUMN_STR16, offsetof (SweepRecord, scenario)},
+  {"nWifi", SWEEP_COLUMN_U32, offsetof (SweepRecord, nWifi)},
+  {"Tcycle", SWEEP_COLUMN_U32, offsetof (SweepRecord, Tcycle)},
+  {"seed", SWEEP_COLUMN_U32, offsetof (SweepRecord, seed)},
+  {"packet_size", SWEEP_COLUMN_U32, offsetof (SweepRecord, packetSize)},
+  {"sent", SWEEP_COLUMN_U64, offsetof (SweepRecord, sent)},
+  {"delivered", SWEEP_COLUMN_U64, offsetof (SweepRecord, delivered)},
+  {"rx_bytes", SWEEP_COLUMN_U64, offsetof (SweepRecord, rxBytes)},
+  {"drops", SWEEP_COLUMN_U64, offsetof (SweepRecord, drops)},
+  {"delivery_ratio", SWEEP_COLUMN_F64, offsetof (SweepRecord, deliveryRatio)},
+  {"drop_rate", SWEEP_COLUMN_F64, offsetof (SweepRecord, dropRate)},
+  {"latency_p50_ms", SWEEP_COLUMN_F64, offsetof (SweepRecord, latencyP50Ms)},
+  {"latency_p90_ms", SWEEP_COLUMN_F64, offsetof (SweepRecord, latencyP90Ms)},
+  {"latency_p99_ms", SWEEP_COLUMN_F64, offsetof (SweepRecord, latencyP99Ms)},
+  {"latency_max_ms", SWEEP_COLUMN_F64, offsetof (SweepRecord, latencyMaxMs)},
+  {"wall_s", SWEEP_COLUMN_F64, offsetof (SweepRecord, wallS)},
+  {"phy_mode", SWEEP_COLUMN_STR16, offsetof (SweepRecord, phyMode)},
+  {"slot_ceiling", SWEEP_COLUMN_U32, offsetof (SweepRecord, slotCeiling)},
+};
+
+static const uint32_t SWEEP_RESULTS_VERSION = 2;
+static const uint32_t SWEEP_RESULTS_COLUMNS = sizeof (g_sweepColumns) / sizeof (g_sweepColumns[0]);
+static const uint32_t SWEEP_RESULTS_V1_COLUMNS = 16;
+
+struct SweepResultsFileHeader
+{
+  char magic[4];            // "SWRC"
+  uint32_t version;
+  uint32_t nColumns;
+  uint32_t reserved;
+};
+
+struct SweepResultsColumnHeader
+{
+  char name[24];
+  uint32_t type;
+  uint32_t reserved;
+};
+
+struct SweepResultsGroupHeader
+{
+  char magic[4];            // "RGRP"
+  uint32_t nRows;
+};
+
+inline uint32_t
+SweepColumnWidth (uint32_t type)
+{
+  switch (type)
+    {
+    case SWEEP_COLUMN_U32:
+      return 4;
+    case SWEEP_COLUMN_U64:
+    case SWEEP_COLUMN_F64:
+      return 8;
+    case SWEEP_COLUMN_STR16:
+      return 16;
+    }
+  return 0;
+}
+
+inline void
+SweepRecordInit (SweepRecord &r, std::string scenario)
+{
+  std::memset (&r, 0, sizeof (r));
+  std::strncpy (r.scenario, scenario.c_str (), sizeof (r.scenario) - 1);
+}
+
+// nColumns gets the file's column count, the first that many of
+// g_sweepColumns
+inline bool
+SweepResultsReadHeader (FILE *f, uint32_t &nColumns)
+{
+  SweepResultsFileHeader header;
+  if (std::fread (&header, sizeof (header), 1, f) != 1
+      || std::memcmp (header.magic, "SWRC", 4) != 0
+      || !((header.version == SWEEP_RESULTS_VERSION && header.nColumns == SWEEP_RESULTS_COLUMNS)
+           || (header.version == 1 && header.nColumns == SWEEP_RESULTS_V1_COLUMNS)))
+    {
+      return false;
+    }
+  nColumns = header.nColumns;
+  for (uint32_t c = 0; c < nColumns; c++)
+    {
+      SweepResultsColumnHeader column;
+      if (std::fread (&column, sizeof (column), 1, f) != 1
+          || std::strncmp (column.name, g_sweepColumns[c].name, sizeof (column.name)) != 0
+          || column.type != g_sweepColumns[c].type)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+inline uint32_t
+SweepResultsRowWidth (uint32_t nColumns)
+{
+  uint32_t rowWidth = 0;
+  for (uint32_t c = 0; c < nColumns; c++)
+    {
+      rowWidth += SweepColumnWidth (g_sweepColumns[c].type);
+    }
+  return rowWidth;
+}
+
+// With f just past the header: the offset where the last complete row
+// group ends. Whatever follows is a group a crash cut short.
+inline long
+SweepResultsGroupsEnd (FILE *f, uint32_t nColumns)
+{
+  long pos = std::ftell (f);
+  std::fseek (f, 0, SEEK_END);
+  long size = std::ftell (f);
+  uint32_t rowWidth = SweepResultsRowWidth (nColumns);
+  SweepResultsGroupHeader header;
+  while (std::fseek (f, pos, SEEK_SET) == 0
+         && std::fread (&header, sizeof (header), 1, f) == 1
+         && std::memcmp (header.magic, "RGRP", 4) == 0
+         && pos + (long)sizeof (header) + (long)header.nRows * rowWidth <= size)
+    {
+      pos += sizeof (header) + (long)header.nRows * rowWidth;
+    }
+  return pos;
+}
+
+class SweepResultsWriter
+{
+public:
+  SweepResultsWriter ();
+  ~SweepResultsWriter ();
+
+  // appends to an existing results file, which must have the same
+  // columns (a version 1 file is moved aside); a group cut short at its
+  // end is cut off first
+  bool Open (std::string path, uint32_t groupRows = 64);
+  void Close (void);
+  bool IsOpen (void) const;
+
+  void Add (const SweepRecord &record);
+  // writes the pending records as one row group
+  void Flush (void);
+
+private:
+  FILE *m_file;
+  uint32_t m_groupRows;
+  std::vector<SweepRecord> m_pending;
+};
+
+inline
+SweepResultsWriter::SweepResultsWriter ()
+  : m_file (0),
+    m_groupRows (64)
+{
+}
+
+inline
+SweepResultsWriter::~SweepResultsWriter ()
+{
+  Close ();
+}
+
+inline bool
+SweepResultsWriter::Open (std::string path, uint32_t groupRows)
+{
+  Close ();
+  m_file = std::fopen (path.c_str (), "a+b");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  m_groupRows = groupRows > 0 ? groupRows : 1;
+  m_pending.clear ();
+
+  std::fseek (m_file, 0, SEEK_END);
+  uint32_t nColumns = 0;
+  if (std::ftell (m_file) > 0)
+    {
+      std::rewind (m_file);
+      if (!SweepResultsReadHeader (m_file, nColumns))
+        {
+          std::fclose (m_file);
+          m_file = 0;
+          return false;
+        }
+    }
+  if (nColumns > 0 && nColumns != SWEEP_RESULTS_COLUMNS)
+    {
+      // an older version: keep it readable under another name rather than
+      // fail every sweep that appends to it
+      std::string old = path + ".v1";
+      std::fclose (m_file);
+      m_file = 0;
+      FILE *taken = std::fopen (old.c_str (), "rb");
+      if (taken != 0)
+        {
+          std::fclose (taken);
+        }
+      if (taken != 0 || std::rename (path.c_str (), old.c_str ()) != 0)
+        {
+          std::fprintf (stderr, "%s is a version 1 results file and %s is taken, move one of them\n",
+                        path.c_str (), old.c_str ());
+          return false;
+        }
+      std::fprintf (stderr, "%s is a version 1 results file, moved to %s; starting a new one\n",
+                    path.c_str (), old.c_str ());
+      m_file = std::fopen (path.c_str (), "a+b");
+      if (m_file == 0)
+        {
+          return false;
+        }
+      nColumns = 0;
+    }
+  if (nColumns > 0)
+    {
+      // appending after the partial bytes would make a reader take the
+      // new group for the rest of the cut one
+      long end = SweepResultsGroupsEnd (m_file, nColumns);
+      std::fseek (m_file, 0, SEEK_END);
+      if (std::ftell (m_file) > end && ftruncate (fileno (m_file), end) != 0)
+        {
+          std::fclose (m_file);
+          m_file = 0;
+          return false;
+        }
+      return true;
+    }
+
+  SweepResultsFileHeader header;
+  std::memcpy (header.magic, "SWRC", 4);
+  header.version = SWEEP_RESULTS_VERSION;
+  header.nColumns = SWEEP_RESULTS_COLUMNS;
+  header.reserved = 0;
+  std::fwrite (&header, sizeof (header), 1, m_file);
+  for (uint32_t c = 0; c < SWEEP_RESULTS_COLUMNS; c++)
+    {
+      SweepResultsColumnHeader column;
+      std::memset (&column, 0, sizeof (column));
+      std::strncpy (column.name, g_sweepColumns[c].name, sizeof (column.name) - 1);
+      column.type = g_sweepColumns[c].type;
+      std::fwrite (&column, sizeof (column), 1, m_file);
+    }
+  std::fflush (m_file);
+  return true;
+}
+
+inline void
+SweepResultsWriter::Close (void)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  Flush ();
+  std::fclose (m_file);
+  m_file = 0;
+}
+
+inline bool
+SweepResultsWriter::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+inline void
+SweepResultsWriter::Add (const SweepRecord &record)
+{
+  if (m_file == 0)
+    {
+      return;
+    }
+  m_pending.push_back (record);
+  if (m_pending.size () >= m_groupRows)
+    {
+      Flush ();
+    }
+}
+
+inline void
+SweepResultsWriter::Flush (void)
+{
+  if (m_file == 0 || m_pending.empty ())
+    {
+      return;
+    }
+  // build the whole group first so it goes out in one write; a reader
+  // drops a group that was cut short
+  std::vector<char> group (sizeof (SweepResultsGroupHeader));
+  SweepResultsGroupHeader header;
+  std::memcpy (header.magic, "RGRP", 4);
+  header.nRows = m_pending.size ();
+  std::memcpy (&group[0], &header, sizeof (header));
+  for (uint32_t c = 0; c < SWEEP_RESULTS_COLUMNS; c++)
+    {
+      uint32_t width = SweepColumnWidth (g_sweepColumns[c].type);
+      for (uint32_t r = 0; r < m_pending.size (); r++)
+        {
+          const char *value = reinterpret_cast<const char *> (&m_pending[r]) + g_sweepColumns[c].offset;
+          group.insert (group.end (), value, value + width);
+        }
+    }
+  // a+ mode: a positioning call has to separate the header read from writes
+  std::fseek (m_file, 0, SEEK_END);
+  std::fwrite (&group[0], 1, group.size (), m_file);
+  std::fflush (m_file);
+  m_pending.clear ();
+}
+
+// Appends every record of the file to records. Returns false if the file
+// is missing or has different columns; a truncated last group is ignored.
+// Version 1 rows come back as phy_mode "11a:0", slot_ceiling 0.
+inline bool
+SweepResultsLoad (std::string path, std::vector<SweepRecord> &records)
+{
+  FILE *f = std::fopen (path.c_str (), "rb");
+  if (f == 0)
+    {
+      return false;
+    }
+  uint32_t nColumns;
+  if (!SweepResultsReadHeader (f, nColumns))
+    {
+      std::fclose (f);
+      return false;
+    }
+  long start = std::ftell (f);
+  long end = SweepResultsGroupsEnd (f, nColumns);
+  std::vector<char> data (end - start);
+  std::fseek (f, start, SEEK_SET);
+  size_t size = data.empty () ? 0 : std::fread (&data[0], 1, data.size (), f);
+  std::fclose (f);
+
+  uint32_t rowWidth = SweepResultsRowWidth (nColumns);
+  size_t pos = 0;
+  while (pos + sizeof (SweepResultsGroupHeader) <= size)
+    {
+      SweepResultsGroupHeader header;
+      std::memcpy (&header, &data[pos], sizeof (header));
+      if (std::memcmp (header.magic, "RGRP", 4) != 0
+          || pos + sizeof (header) + (size_t)header.nRows * rowWidth > size)
+        {
+          break;
+        }
+      pos += sizeof (header);
+      size_t first = records.size ();
+      records.resize (first + header.nRows);
+      for (uint32_t c = 0; c < nColumns; c++)
+        {
+          uint32_t width = SweepColumnWidth (g_sweepColumns[c].type);
+          for (uint32_t r = 0; r < header.nRows; r++)
+            {
+              char *value = reinterpret_cast<char *> (&records[first + r]) + g_sweepColumns[c].offset;
+              std::memcpy (value, &data[pos], width);
+              pos += width;
+            }
+        }
+      if (nColumns == SWEEP_RESULTS_V1_COLUMNS)
+        {
+          // before phy modes every run was the ns-3 default, 802.11a at 6 Mbit/s
+          for (uint32_t r = 0; r < header.nRows; r++)
+            {
+              std::strncpy (records[first + r].phyMode, "11a:0", sizeof (records[first + r].phyMode) - 1);
+            }
+        }
+    }
+  return true;
+}
+
+inline void
+SweepResultsWriteCsvHeader (std::ostream &os)
+{
+  for (uint32_t c = 0; c < SWEEP_RESULTS_COLUMNS; c++)
+    {
+      os << (c > 0 ? "," : "") << g_sweepColumns[c].name;
+    }
+  os << "\n";
+}
+
+inline void
+SweepResultsWriteCsv (std::ostream &os, const SweepRecord &r)
+{
+  for (uint32_t c = 0; c < SWEEP_RESULTS_COLUMNS; c++)
+    {
+      const char *value = reinterpret_cast<const char *> (&r) + g_sweepColumns[c].offset;
+      if (c > 0)
+        {
+          os << ",";
+        }
+      switch (g_sweepColumns[c].type)
+        {
+        case SWEEP_COLUMN_U32:
+          os << *reinterpret_cast<const uint32_t *> (value);
+          break;
+        case SWEEP_COLUMN_U64:
+          os << *reinterpret_cast<const uint64_t *> (value);
+          break;
+        case SWEEP_COLUMN_F64:
+          os << *reinterpret_cast<const double *> (value);
+          break;
+        case SWEEP_COLUMN_STR16:
+          os << std::string (value, strnlen (value, 16));
+          break;
+        }
+    }
+  os << "\n";
+}
+
+#endif /* SWEEP_RESULTS_H */
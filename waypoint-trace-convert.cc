@@ -0,0 +1,249 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Converts an ns-2 movement file (setdest / set X_ Y_ Z_) into the binary
+// waypoint trace read by WaypointTraceMobilityModel, so the text is parsed
+// once instead of at the start of every simulation:
+//
+//   ./waf --run "waypoint-trace-convert --input=moves.ns2 --output=moves.wpt"
+
+#include "ns3/core-module.h"
+
+#include "waypoint-trace-mobility-model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("WaypointTraceConvert");
+
+struct Ns2Command
+{
+  double t;
+  bool setdest;   // otherwise a "set X_/Y_/Z_" jump
+  char axis;
+  double x, y, speed;
+};
+
+struct Ns2Node
+{
+  double pos[3];
+  std::vector<Ns2Command> commands;
+};
+
+static bool
+CommandBefore (const Ns2Command &a, const Ns2Command &b)
+{
+  return a.t < b.t;
+}
+
+static WaypointTraceRecord
+MakeRecord (double t, const double *pos)
+{
+  WaypointTraceRecord r;
+  r.timeNs = (int64_t) std::llround (t * 1e9);
+  r.x = pos[0];
+  r.y = pos[1];
+  r.z = pos[2];
+  r.reserved = 0;
+  return r;
+}
+
+// "$node_(12)" -> 12, -1 when the token is not a node reference
+static int
+NodeId (const std::string &token)
+{
+  std::string::size_type open = token.find ("$node_(");
+  std::string::size_type close = token.find (')');
+  if (open == std::string::npos || close == std::string::npos)
+    {
+      return -1;
+    }
+  return std::atoi (token.substr (open + 7, close - open - 7).c_str ());
+}
+
+static void
+ParseLine (const std::string &line, std::vector<Ns2Node> &nodes)
+{
+  std::string text = line;
+  std::replace (text.begin (), text.end (), '"', ' ');
+  std::istringstream iss (text);
+  std::string first;
+  iss >> first;
+
+  double t = -1;
+  std::string nodeToken;
+  if (first == "$ns_")
+    {
+      std::string at;
+      iss >> at >> t >> nodeToken;
+    }
+  else
+    {
+      nodeToken = first;
+    }
+  int id = NodeId (nodeToken);
+  if (id < 0)
+    {
+      return;
+    }
+  if ((uint32_t)id >= nodes.size ())
+    {
+      Ns2Node empty = {{0, 0, 0}, std::vector<Ns2Command> ()};
+      nodes.resize (id + 1, empty);
+    }
+
+  std::string verb;
+  iss >> verb;
+  Ns2Command c;
+  c.t = t;
+  c.axis = 0;
+  c.x = c.y = c.speed = 0;
+  if (verb == "setdest")
+    {
+      c.setdest = true;
+      iss >> c.x >> c.y >> c.speed;
+    }
+  else if (verb == "set")
+    {
+      std::string axis;
+      double value;
+      iss >> axis >> value;
+      c.setdest = false;
+      c.axis = axis.empty () ? 0 : axis[0];
+      c.x = value;
+      if (c.axis < 'X' || c.axis > 'Z')
+        {
+          return;
+        }
+    }
+  else
+    {
+      return;
+    }
+  if (!iss)
+    {
+      NS_LOG_WARN ("Skipping malformed line: " << line);
+      return;
+    }
+
+  if (t < 0 && !c.setdest)
+    {
+      // initial position
+      nodes[id].pos[c.axis - 'X'] = c.x;
+      return;
+    }
+  nodes[id].commands.push_back (c);
+}
+
+// Replays the commands of one node and emits a waypoint at every point
+// where its velocity changes.
+static std::vector<WaypointTraceRecord>
+Waypoints (Ns2Node node)
+{
+  std::vector<WaypointTraceRecord> out;
+  std::stable_sort (node.commands.begin (), node.commands.end (), CommandBefore);
+
+  double pos[3] = {node.pos[0], node.pos[1], node.pos[2]};
+  double from[3] = {pos[0], pos[1], pos[2]};
+  double to[3] = {pos[0], pos[1], pos[2]};
+  double start = 0, arrival = 0;
+  out.push_back (MakeRecord (0, pos));
+
+  for (std::vector<Ns2Command>::const_iterator c = node.commands.begin (); c != node.commands.end (); ++c)
+    {
+      if (arrival > start && c->t >= arrival)
+        {
+          out.push_back (MakeRecord (arrival, to));
+        }
+      double alpha = arrival > start ? std::min (1.0, (c->t - start) / (arrival - start)) : 1.0;
+      for (int a = 0; a < 3; a++)
+        {
+          pos[a] = from[a] + alpha * (to[a] - from[a]);
+        }
+      // a leg still under way is cut short here
+      out.push_back (MakeRecord (c->t, pos));
+
+      if (c->setdest)
+        {
+          double dx = c->x - pos[0], dy = c->y - pos[1];
+          double distance = std::sqrt (dx * dx + dy * dy);
+          from[0] = pos[0]; from[1] = pos[1]; from[2] = pos[2];
+          to[0] = c->x; to[1] = c->y; to[2] = pos[2];
+          start = c->t;
+          arrival = (c->speed > 0 && distance > 0) ? c->t + distance / c->speed : c->t;
+        }
+      else
+        {
+          pos[c->axis - 'X'] = c->x;
+          out.push_back (MakeRecord (c->t, pos));
+          from[0] = to[0] = pos[0];
+          from[1] = to[1] = pos[1];
+          from[2] = to[2] = pos[2];
+          start = arrival = c->t;
+        }
+    }
+  if (arrival > start)
+    {
+      out.push_back (MakeRecord (arrival, to));
+    }
+  return out;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string input;
+  std::string output = "waypoints.wpt";
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "ns-2 movement file", input);
+  cmd.AddValue ("output", "Binary waypoint trace to write", output);
+  cmd.Parse (argc,argv);
+
+  std::ifstream ifs (input.c_str ());
+  if (!ifs)
+    {
+      std::cerr << "Cannot open " << input << std::endl;
+      return 1;
+    }
+
+  std::vector<Ns2Node> nodes;
+  std::string line;
+  while (std::getline (ifs, line))
+    {
+      ParseLine (line, nodes);
+    }
+
+  std::vector< std::vector<WaypointTraceRecord> > records;
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      records.push_back (Waypoints (nodes[i]));
+      total += records.back ().size ();
+    }
+  WaypointTraceFile::Write (output, records);
+
+  std::cout << nodes.size () << " nodes, " << total << " waypoints -> " << output << std::endl;
+  return 0;
+}
@@ -0,0 +1,315 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WAYPOINT_TRACE_MOBILITY_MODEL_H
+#define WAYPOINT_TRACE_MOBILITY_MODEL_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+/*
+ * Binary waypoint trace, host byte order:
+ *
+ *   WaypointTraceHeader
+ *   WaypointTraceIndex    x nNodes   (offset/count into the record area)
+ *   WaypointTraceRecord   x total    (each node's records sorted by time)
+ *
+ * Written by waypoint-trace-convert from ns-2 movement files.
+ */
+struct WaypointTraceHeader
+{
+  char magic[4];      // "WPT1"
+  uint32_t version;
+  uint32_t nNodes;
+  uint32_t reserved;
+};
+
+struct WaypointTraceIndex
+{
+  uint64_t offset;    // first record of the node, counted in records
+  uint64_t count;
+};
+
+struct WaypointTraceRecord
+{
+  int64_t timeNs;
+  float x;
+  float y;
+  float z;
+  uint32_t reserved;
+};
+
+static const uint32_t WAYPOINT_TRACE_VERSION = 1;
+
+/*
+ * Read-only mapping of a trace file, shared by the mobility models of all
+ * nodes. Pages are only touched when a node's position is asked for.
+ */
+class WaypointTraceFile : public SimpleRefCount<WaypointTraceFile>
+{
+public:
+  WaypointTraceFile (std::string path);
+  ~WaypointTraceFile ();
+
+  uint32_t GetNNodes (void) const;
+  const WaypointTraceRecord * GetRecords (uint32_t node, uint64_t &count) const;
+
+  static void Write (std::string path, const std::vector< std::vector<WaypointTraceRecord> > &nodes);
+
+private:
+  int m_fd;
+  void *m_base;
+  size_t m_size;
+  const WaypointTraceHeader *m_header;
+  const WaypointTraceIndex *m_index;
+  const WaypointTraceRecord *m_records;
+  uint64_t m_nRecords;
+};
+
+WaypointTraceFile::WaypointTraceFile (std::string path)
+  : m_fd (-1),
+    m_base (0),
+    m_size (0)
+{
+  m_fd = open (path.c_str (), O_RDONLY);
+  NS_ABORT_MSG_IF (m_fd < 0, "Cannot open waypoint trace " << path);
+  struct stat st;
+  NS_ABORT_MSG_IF (fstat (m_fd, &st) != 0, "Cannot stat waypoint trace " << path);
+  m_size = st.st_size;
+  NS_ABORT_MSG_IF (m_size < sizeof (WaypointTraceHeader), "Truncated waypoint trace " << path);
+
+  m_base = mmap (0, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  NS_ABORT_MSG_IF (m_base == MAP_FAILED, "Cannot map waypoint trace " << path);
+  // lookups jump between nodes, read-ahead would mostly be wasted
+  madvise (m_base, m_size, MADV_RANDOM);
+
+  m_header = static_cast<const WaypointTraceHeader *> (m_base);
+  NS_ABORT_MSG_IF (std::memcmp (m_header->magic, "WPT1", 4) != 0
+                   || m_header->version != WAYPOINT_TRACE_VERSION,
+                   "Not a waypoint trace: " << path);
+
+  size_t indexEnd = sizeof (WaypointTraceHeader) + m_header->nNodes * sizeof (WaypointTraceIndex);
+  NS_ABORT_MSG_IF (m_size < indexEnd, "Truncated waypoint trace " << path);
+  m_index = reinterpret_cast<const WaypointTraceIndex *> (m_header + 1);
+  m_records = reinterpret_cast<const WaypointTraceRecord *> (m_index + m_header->nNodes);
+  m_nRecords = (m_size - indexEnd) / sizeof (WaypointTraceRecord);
+
+  for (uint32_t i = 0; i < m_header->nNodes; i++)
+    {
+      NS_ABORT_MSG_IF (m_index[i].offset + m_index[i].count > m_nRecords,
+                       "Waypoint trace index out of range for node " << i);
+    }
+}
+
+WaypointTraceFile::~WaypointTraceFile ()
+{
+  munmap (m_base, m_size);
+  close (m_fd);
+}
+
+uint32_t
+WaypointTraceFile::GetNNodes (void) const
+{
+  return m_header->nNodes;
+}
+
+const WaypointTraceRecord *
+WaypointTraceFile::GetRecords (uint32_t node, uint64_t &count) const
+{
+  NS_ASSERT (node < m_header->nNodes);
+  count = m_index[node].count;
+  return m_records + m_index[node].offset;
+}
+
+void
+WaypointTraceFile::Write (std::string path, const std::vector< std::vector<WaypointTraceRecord> > &nodes)
+{
+  FILE *f = std::fopen (path.c_str (), "wb");
+  NS_ABORT_MSG_IF (f == 0, "Cannot create waypoint trace " << path);
+
+  WaypointTraceHeader header;
+  std::memcpy (header.magic, "WPT1", 4);
+  header.version = WAYPOINT_TRACE_VERSION;
+  header.nNodes = nodes.size ();
+  header.reserved = 0;
+  std::fwrite (&header, sizeof (header), 1, f);
+
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      WaypointTraceIndex index;
+      index.offset = offset;
+      index.count = nodes[i].size ();
+      std::fwrite (&index, sizeof (index), 1, f);
+      offset += index.count;
+    }
+  for (uint32_t i = 0; i < nodes.size (); i++)
+    {
+      if (!nodes[i].empty ())
+        {
+          std::fwrite (&nodes[i][0], sizeof (WaypointTraceRecord), nodes[i].size (), f);
+        }
+    }
+  NS_ABORT_MSG_IF (std::fclose (f) != 0, "Cannot write waypoint trace " << path);
+}
+
+/*
+ * Linear interpolation between the recorded waypoints of one node. Nothing
+ * is scheduled: the current segment is found when the position is queried,
+ * and CourseChange fires at that point if a waypoint has been passed.
+ * Before the first waypoint and after the last one the node stands still.
+ */
+class WaypointTraceMobilityModel : public MobilityModel
+{
+public:
+  static TypeId GetTypeId (void);
+  WaypointTraceMobilityModel ();
+
+  void SetTrace (Ptr<WaypointTraceFile> trace, uint32_t node);
+
+private:
+  virtual Vector DoGetPosition (void) const;
+  virtual void DoSetPosition (const Vector &position);
+  virtual Vector DoGetVelocity (void) const;
+
+  void Seek (int64_t timeNs) const;
+
+  Ptr<WaypointTraceFile> m_trace;
+  const WaypointTraceRecord *m_records;
+  uint64_t m_count;
+  mutable uint64_t m_current; // last waypoint at or before now
+};
+
+NS_OBJECT_ENSURE_REGISTERED (WaypointTraceMobilityModel);
+
+TypeId
+WaypointTraceMobilityModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::WaypointTraceMobilityModel")
+    .SetParent<MobilityModel> ()
+    .AddConstructor<WaypointTraceMobilityModel> ()
+  ;
+  return tid;
+}
+
+WaypointTraceMobilityModel::WaypointTraceMobilityModel ()
+  : m_records (0),
+    m_count (0),
+    m_current (0)
+{
+}
+
+void
+WaypointTraceMobilityModel::SetTrace (Ptr<WaypointTraceFile> trace, uint32_t node)
+{
+  m_trace = trace;
+  m_records = trace->GetRecords (node, m_count);
+  NS_ABORT_MSG_IF (m_count == 0, "No waypoints for node " << node);
+  m_current = 0;
+}
+
+void
+WaypointTraceMobilityModel::Seek (int64_t timeNs) const
+{
+  bool behind = m_current + 1 < m_count && m_records[m_current + 1].timeNs <= timeNs;
+  bool ahead = m_current > 0 && m_records[m_current].timeNs > timeNs;
+  if (!behind && !ahead)
+    {
+      return;
+    }
+
+  WaypointTraceRecord key;
+  key.timeNs = timeNs;
+  const WaypointTraceRecord *next = std::upper_bound (m_records, m_records + m_count, key,
+                                                      [] (const WaypointTraceRecord &a, const WaypointTraceRecord &b)
+                                                      { return a.timeNs < b.timeNs; });
+  m_current = next == m_records ? 0 : (next - m_records) - 1;
+  NotifyCourseChange ();
+}
+
+Vector
+WaypointTraceMobilityModel::DoGetPosition (void) const
+{
+  int64_t now = Simulator::Now ().GetNanoSeconds ();
+  Seek (now);
+  const WaypointTraceRecord &from = m_records[m_current];
+  if (m_current + 1 >= m_count || now <= from.timeNs)
+    {
+      return Vector (from.x, from.y, from.z);
+    }
+  const WaypointTraceRecord &to = m_records[m_current + 1];
+  double alpha = (double)(now - from.timeNs) / (double)(to.timeNs - from.timeNs);
+  return Vector (from.x + alpha * (to.x - from.x),
+                 from.y + alpha * (to.y - from.y),
+                 from.z + alpha * (to.z - from.z));
+}
+
+Vector
+WaypointTraceMobilityModel::DoGetVelocity (void) const
+{
+  int64_t now = Simulator::Now ().GetNanoSeconds ();
+  Seek (now);
+  const WaypointTraceRecord &from = m_records[m_current];
+  if (m_current + 1 >= m_count || now < from.timeNs)
+    {
+      return Vector (0, 0, 0);
+    }
+  const WaypointTraceRecord &to = m_records[m_current + 1];
+  double dt = (to.timeNs - from.timeNs) * 1e-9;
+  return Vector ((to.x - from.x) / dt, (to.y - from.y) / dt, (to.z - from.z) / dt);
+}
+
+void
+WaypointTraceMobilityModel::DoSetPosition (const Vector &position)
+{
+  NS_FATAL_ERROR ("WaypointTraceMobilityModel positions come from the trace file");
+}
+
+/*
+ * Node i of the container follows trace entry i. Installed directly rather
+ * than through MobilityHelper, which would try to SetPosition.
+ */
+inline void
+InstallWaypointTrace (NodeContainer nodes, std::string path)
+{
+  Ptr<WaypointTraceFile> trace = Create<WaypointTraceFile> (path);
+  NS_ABORT_MSG_IF (trace->GetNNodes () < nodes.GetN (),
+                   path << " holds " << trace->GetNNodes () << " nodes, " << nodes.GetN () << " needed");
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<WaypointTraceMobilityModel> model = CreateObject<WaypointTraceMobilityModel> ();
+      model->SetTrace (trace, i);
+      nodes.Get (i)->AggregateObject (model);
+    }
+}
+
+} // namespace ns3
+
+#endif /* WAYPOINT_TRACE_MOBILITY_MODEL_H */
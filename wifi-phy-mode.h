@@ -0,0 +1,179 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WIFI_PHY_MODE_H
+#define WIFI_PHY_MODE_H
+
+#include "ns3/core-module.h"
+#include "ns3/wifi-module.h"
+
+#include "slot-airtime.h"
+
+#include <sstream>
+#include <string>
+
+namespace ns3 {
+
+/*
+ * Standard and data rate of every wifi device of a scenario, given on the
+ * command line as "standard:mcs":
+ *
+ *   11a:0..7    OfdmRate6Mbps .. OfdmRate54Mbps (the default, 11a:0, is
+ *               what the scenarios always ran: the ns-3 default standard
+ *               and ConstantRateWifiManager's default rate)
+ *   11n:0..7    HtMcs0..7
+ *   11ac:0..8   VhtMcs0..8
+ *   11ax:0..11  HeMcs0..11
+ *
+ * All at 20 MHz, one stream, 800 ns guard interval, matching the slot
+ * timing in slot-airtime.h. With ConstantRateWifiManager the MCS is the
+ * data rate; other managers pick their own and only the standard applies.
+ *
+ * The sensitivities are the 802.11 minimum input levels at 20 MHz, which
+ * assume a 10 dB noise figure and 5 dB implementation margin; planners
+ * take the SINR a rate needs as its sensitivity over that -91 dBm floor.
+ */
+struct WifiPhyMode
+{
+  std::string name;       // as given, for reports and sweep records
+  WifiPhyStandard standard;
+  std::string dataMode;
+  SlotPhy slot;
+  double sensitivityDbm;
+  double ackSensitivityDbm;   // the legacy control rate of slot's ACK
+};
+
+static const double WIFI_SENSITIVITY_NOISE_DBM = -91;
+
+// HT, VHT and HE MCS 0..11 share the levels at 20 MHz
+static const double HT_SENSITIVITY[] = {-82, -79, -77, -74, -70, -66, -65, -64, -59, -57, -54, -52};
+
+inline bool
+ParseWifiPhyMode (std::string spec, WifiPhyMode &mode)
+{
+  std::string standard = spec.substr (0, spec.find (':'));
+  uint32_t mcs = 0;
+  if (spec.find (':') != std::string::npos)
+    {
+      std::istringstream is (spec.substr (spec.find (':') + 1));
+      // the whole rest is the MCS: no "11n:7x"
+      if (!(is >> mcs) || !is.eof ())
+        {
+          return false;
+        }
+    }
+  std::ostringstream dataMode;
+  mode.name = spec;
+  if (standard == "11a")
+    {
+      static const uint32_t rates[] = {6, 9, 12, 18, 24, 36, 48, 54};
+      if (mcs >= sizeof (rates) / sizeof (rates[0]))
+        {
+          return false;
+        }
+      mode.standard = WIFI_PHY_STANDARD_80211a;
+      dataMode << "OfdmRate" << rates[mcs] << "Mbps";
+      static const double sensitivity[] = {-82, -81, -79, -77, -74, -70, -66, -65};
+      mode.slot = SlotPhyOfdm (rates[mcs]);
+      mode.sensitivityDbm = sensitivity[mcs];
+    }
+  else if (standard == "11n")
+    {
+      mode.standard = WIFI_PHY_STANDARD_80211n_5GHZ;
+      dataMode << "HtMcs" << mcs;
+      if (!SlotPhyHt (mcs, mode.slot))
+        {
+          return false;
+        }
+      mode.sensitivityDbm = HT_SENSITIVITY[mcs];
+    }
+  else if (standard == "11ac")
+    {
+      mode.standard = WIFI_PHY_STANDARD_80211ac;
+      dataMode << "VhtMcs" << mcs;
+      if (!SlotPhyVht (mcs, mode.slot))
+        {
+          return false;
+        }
+      mode.sensitivityDbm = HT_SENSITIVITY[mcs];
+    }
+  else if (standard == "11ax")
+    {
+      mode.standard = WIFI_PHY_STANDARD_80211ax_5GHZ;
+      dataMode << "HeMcs" << mcs;
+      if (!SlotPhyHe (mcs, mode.slot))
+        {
+          return false;
+        }
+      mode.sensitivityDbm = HT_SENSITIVITY[mcs];
+    }
+  else
+    {
+      return false;
+    }
+  mode.dataMode = dataMode.str ();
+  uint32_t ackRate = mode.slot.ackBitsPerSymbol / 4;
+  mode.ackSensitivityDbm = ackRate >= 24 ? -74 : ackRate >= 12 ? -79 : -82;
+  return true;
+}
+
+// The rate manager when none is given: Aarf has no HT rates, Minstrel
+// takes over from 11n on
+inline std::string
+DefaultRateManager (const WifiPhyMode &mode)
+{
+  return mode.standard == WIFI_PHY_STANDARD_80211a ? "ns3::AarfWifiManager" : "ns3::MinstrelHtWifiManager";
+}
+
+// Before Install: standard and rate manager
+inline void
+ApplyWifiPhyMode (WifiHelper &wifi, const WifiPhyMode &mode, std::string rateManager)
+{
+  NS_ABORT_MSG_IF (mode.standard != WIFI_PHY_STANDARD_80211a && rateManager != "ns3::ConstantRateWifiManager"
+                   && rateManager != "ns3::IdealWifiManager" && rateManager != "ns3::MinstrelHtWifiManager",
+                   rateManager << " has no HT rates, " << mode.name << " needs ConstantRate, Ideal or MinstrelHt");
+  wifi.SetStandard (mode.standard);
+  if (rateManager == "ns3::ConstantRateWifiManager")
+    {
+      // broadcast data (group ACK, slot maps) goes at the same rate
+      wifi.SetRemoteStationManager (rateManager,
+                                    "DataMode", StringValue (mode.dataMode),
+                                    "NonUnicastMode", StringValue (mode.dataMode));
+    }
+  else
+    {
+      wifi.SetRemoteStationManager (rateManager);
+    }
+}
+
+// After Install: 11ac and 11ax default to 80 MHz and 11ax to a 3.2 us GI
+inline void
+ConfigureWifiPhyMode (const WifiPhyMode &mode)
+{
+  if (mode.standard == WIFI_PHY_STANDARD_80211a)
+    {
+      return;
+    }
+  Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/ChannelWidth", UintegerValue (20));
+  if (mode.standard == WIFI_PHY_STANDARD_80211ax_5GHZ)
+    {
+      Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/Phy/GuardInterval", TimeValue (NanoSeconds (800)));
+    }
+}
+
+} // namespace ns3
+
+#endif /* WIFI_PHY_MODE_H */